@@ -23,6 +23,24 @@ using android::base::Result;
 
 namespace {
 
+// Fields are encoded positionally, so new fields may only be appended.
+bool AreStructFieldsCompatible(const sysprop::Property& latest,
+                               const sysprop::Property& current) {
+  if (latest.struct_fields_size() > current.struct_fields_size()) return false;
+
+  for (int i = 0; i < latest.struct_fields_size(); ++i) {
+    const auto& latest_field = latest.struct_fields(i);
+    const auto& current_field = current.struct_fields(i);
+    if (latest_field.name() != current_field.name() ||
+        latest_field.type() != current_field.type() ||
+        latest_field.enum_values() != current_field.enum_values()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 Result<void> CompareProps(const sysprop::Properties& latest,
                           const sysprop::Properties& current) {
   std::unordered_map<std::string, sysprop::Property> props;
@@ -72,6 +90,10 @@ Result<void> CompareProps(const sysprop::Properties& latest,
       err += "Enum values of prop " + latest_prop.api_name() +
              " has been changed\n";
     }
+    if (!AreStructFieldsCompatible(latest_prop, current_prop)) {
+      err += "Struct fields of prop " + latest_prop.api_name() +
+             " has been changed\n";
+    }
     if (latest_prop.integer_as_bool() != current_prop.integer_as_bool()) {
       err += "Integer-as-bool of prop " + latest_prop.api_name() +
              " has been changed\n";
@@ -35,6 +35,7 @@
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <google/protobuf/text_format.h>
 
@@ -47,6 +48,9 @@ namespace {
 std::string GenerateDefaultPropName(const sysprop::Properties& props,
                                     const sysprop::Property& prop);
 bool IsCorrectIdentifier(const std::string& name);
+Result<void> ValidateEnumValues(const std::string& enum_values,
+                                const std::string& api_name);
+Result<void> ValidateStructFields(const sysprop::Property& prop);
 Result<void> ValidateProp(const sysprop::Properties& props,
                           const sysprop::Property& prop);
 Result<void> ValidateProps(const sysprop::Properties& props);
@@ -105,6 +109,73 @@ bool IsCorrectApiName(const std::string& name) {
   return IsCorrectName(name, allowed);
 }
 
+Result<void> ValidateEnumValues(const std::string& enum_values,
+                                const std::string& api_name) {
+  std::vector<std::string> names = android::base::Split(enum_values, "|");
+  if (names.empty()) {
+    return Errorf("Enum values are empty for API \"{}\"", api_name);
+  }
+
+  for (const std::string& name : names) {
+    if (!IsCorrectIdentifier(name)) {
+      return Errorf("Invalid enum value \"{}\" for API \"{}\"", name,
+                    api_name);
+    }
+  }
+
+  std::unordered_set<std::string> name_set;
+  for (const std::string& name : names) {
+    if (!name_set.insert(ToUpper(name)).second) {
+      return Errorf("Duplicated enum value \"{}\" for API \"{}\"", name,
+                    api_name);
+    }
+  }
+
+  return {};
+}
+
+Result<void> ValidateStructFields(const sysprop::Property& prop) {
+  if (prop.struct_fields_size() == 0) {
+    return Errorf("Struct fields are empty for API \"{}\"", prop.api_name());
+  }
+
+  std::unordered_set<std::string> name_set;
+  for (const sysprop::StructField& field : prop.struct_fields()) {
+    if (!IsCorrectIdentifier(field.name())) {
+      return Errorf("Invalid struct field name \"{}\" for API \"{}\"",
+                    field.name(), prop.api_name());
+    }
+
+    if (!name_set.insert(field.name()).second) {
+      return Errorf("Duplicated struct field \"{}\" for API \"{}\"",
+                    field.name(), prop.api_name());
+    }
+
+    switch (field.type()) {
+      case sysprop::Boolean:
+      case sysprop::Integer:
+      case sysprop::Long:
+      case sysprop::Double:
+      case sysprop::String:
+        break;
+      case sysprop::Enum:
+        if (auto res = ValidateEnumValues(field.enum_values(),
+                                          prop.api_name() + "." + field.name());
+            !res.ok()) {
+          return res;
+        }
+        break;
+      default:
+        return Errorf(
+            "Struct field \"{}\" for API \"{}\" should have a non-list, "
+            "non-struct type",
+            field.name(), prop.api_name());
+    }
+  }
+
+  return {};
+}
+
 Result<void> ValidateProp(const sysprop::Properties& props,
                           const sysprop::Property& prop) {
   if (!IsCorrectApiName(prop.api_name())) {
@@ -112,26 +183,17 @@ Result<void> ValidateProp(const sysprop::Properties& props,
   }
 
   if (prop.type() == sysprop::Enum || prop.type() == sysprop::EnumList) {
-    std::vector<std::string> names =
-        android::base::Split(prop.enum_values(), "|");
-    if (names.empty()) {
-      return Errorf("Enum values are empty for API \"{}\"", prop.api_name());
-    }
-
-    for (const std::string& name : names) {
-      if (!IsCorrectIdentifier(name)) {
-        return Errorf("Invalid enum value \"{}\" for API \"{}\"", name,
-                      prop.api_name());
-      }
+    if (auto res = ValidateEnumValues(prop.enum_values(), prop.api_name());
+        !res.ok()) {
+      return res;
     }
+  }
 
-    std::unordered_set<std::string> name_set;
-    for (const std::string& name : names) {
-      if (!name_set.insert(ToUpper(name)).second) {
-        return Errorf("Duplicated enum value \"{}\" for API \"{}\"", name,
-                      prop.api_name());
-      }
-    }
+  if (prop.type() == sysprop::Struct) {
+    if (auto res = ValidateStructFields(prop); !res.ok()) return res;
+  } else if (prop.struct_fields_size() != 0) {
+    return Errorf("API \"{}\" has struct fields, but is not a struct",
+                  prop.api_name());
   }
 
   std::string prop_name = prop.prop_name();
@@ -269,6 +331,27 @@ bool IsListProp(const sysprop::Property& prop) {
   }
 }
 
+bool IsMapProp(const sysprop::Property& prop) {
+  switch (prop.type()) {
+    case sysprop::BooleanMap:
+    case sysprop::IntegerMap:
+    case sysprop::LongMap:
+    case sysprop::DoubleMap:
+    case sysprop::StringMap:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// EnumList properties whose values fit in a 64-bit mask also get flag-set
+// accessors.
+bool HasEnumFlags(const sysprop::Property& prop) {
+  return prop.type() == sysprop::EnumList &&
+         std::count(prop.enum_values().begin(), prop.enum_values().end(),
+                    '|') < 64;
+}
+
 std::string GetModuleName(const sysprop::Properties& props) {
   const std::string& module = props.module();
   return module.substr(module.rfind('.') + 1);
@@ -328,6 +411,148 @@ Result<sysprop::SyspropLibraryApis> ParseApiFile(
   return ret;
 }
 
+Result<sysprop::AccessProfile> ParseAccessProfile(
+    const std::string& input_file_path) {
+  sysprop::AccessProfile ret;
+  std::string file_contents;
+
+  if (!android::base::ReadFileToString(input_file_path, &file_contents, true)) {
+    return ErrnoErrorf("Error reading file {}", input_file_path);
+  }
+
+  if (!google::protobuf::TextFormat::ParseFromString(file_contents, &ret)) {
+    return Errorf("Error parsing file {}", input_file_path);
+  }
+
+  if (!(ret.duration_seconds() > 0)) {
+    return Errorf("Error parsing file {}: duration_seconds must be positive",
+                  input_file_path);
+  }
+
+  std::unordered_set<std::string> api_names;
+
+  for (const sysprop::PropertyProfile& prop : ret.prop()) {
+    if (!api_names.insert(prop.api_name()).second) {
+      return Errorf("Error parsing file {}: duplicated api_name {}",
+                    input_file_path, prop.api_name());
+    }
+    if (!(prop.changes_per_second() >= 0)) {
+      return Errorf("Error parsing file {}: invalid changes_per_second of {}",
+                    input_file_path, prop.api_name());
+    }
+  }
+
+  return ret;
+}
+
+// Properties read less often than this are left to plain reads, so that
+// caches are only paid for where they pay off.
+constexpr double kMinCachedReadsPerSecond = 1.0;
+
+// Serial caches revalidate on every read, which only pays off when values
+// are read several times between changes.
+constexpr double kMinReadsPerChange = 10.0;
+
+namespace {
+
+// Serial caches publish values without locks, which needs values which can be
+// copied word by word.
+bool HasSerialCacheType(const sysprop::Property& prop) {
+  switch (prop.type()) {
+    case sysprop::Boolean:
+    case sysprop::Integer:
+    case sysprop::Long:
+    case sysprop::Double:
+    case sysprop::Enum:
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+std::vector<PropAccess> ChooseAccessStrategies(
+    const sysprop::Properties& props, const sysprop::AccessProfile& profile,
+    bool has_serial_cache) {
+  std::vector<PropAccess> ret(props.prop_size());
+
+  for (int i = 0; i < props.prop_size(); ++i) {
+    const sysprop::Property& prop = props.prop(i);
+    auto it = std::find_if(profile.prop().begin(), profile.prop().end(),
+                           [&](const sysprop::PropertyProfile& entry) {
+                             return entry.api_name() == prop.api_name();
+                           });
+    if (it == profile.prop().end()) {
+      ret[i].reason = "not profiled";
+      continue;
+    }
+
+    double reads_per_second = it->reads() / profile.duration_seconds();
+    double changes_per_second = std::max(
+        it->changes_per_second(), it->writes() / profile.duration_seconds());
+    std::string rates =
+        android::base::StringPrintf("%.2f reads/s, %.2f changes/s",
+                                    reads_per_second, changes_per_second);
+
+    if (reads_per_second < kMinCachedReadsPerSecond) {
+      ret[i].reason = "rarely read, " + rates;
+    } else if (android::base::StartsWith(prop.prop_name(), "ro.")) {
+      ret[i].strategy = AccessStrategy::kMemoize;
+      ret[i].reason = "immutable once set, " + rates;
+    } else if (reads_per_second < changes_per_second * kMinReadsPerChange) {
+      ret[i].strategy = AccessStrategy::kCachedHandle;
+      ret[i].reason = "changes too often to cache, " + rates;
+    } else if (has_serial_cache && HasSerialCacheType(prop)) {
+      ret[i].strategy = AccessStrategy::kSerialCache;
+      ret[i].reason = "read more often than changed, " + rates;
+    } else if (has_serial_cache) {
+      ret[i].strategy = AccessStrategy::kCachedHandle;
+      ret[i].reason = "read more often than changed but serial caches only "
+                      "hold scalars, " + rates;
+    } else {
+      ret[i].strategy = AccessStrategy::kCachedHandle;
+      ret[i].reason = "read more often than changed but serial caches are "
+                      "unsupported, " + rates;
+    }
+  }
+
+  return ret;
+}
+
+std::string FormatAccessReport(const sysprop::Properties& props,
+                               const sysprop::AccessProfile& profile,
+                               const std::vector<PropAccess>& accesses) {
+  static constexpr const char* kStrategyNames[] = {
+      "plain",
+      "cached-handle",
+      "serial-cache",
+      "memoize",
+  };
+
+  std::string ret = android::base::StringPrintf(
+      "# Access strategies of %s, from a profile of %.2f seconds.\n",
+      props.module().c_str(), profile.duration_seconds());
+
+  for (int i = 0; i < props.prop_size(); ++i) {
+    ret += props.prop(i).api_name() + ": " +
+           kStrategyNames[static_cast<int>(accesses[i].strategy)] + " (" +
+           accesses[i].reason + ")\n";
+  }
+
+  for (const sysprop::PropertyProfile& entry : profile.prop()) {
+    auto it = std::find_if(props.prop().begin(), props.prop().end(),
+                           [&](const sysprop::Property& prop) {
+                             return prop.api_name() == entry.api_name();
+                           });
+    if (it == props.prop().end()) {
+      ret += "# Ignored unknown property " + entry.api_name() + "\n";
+    }
+  }
+
+  return ret;
+}
+
 std::string ToUpper(std::string str) {
   for (char& ch : str) {
     ch = toupper(ch);
@@ -22,10 +22,14 @@
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <algorithm>
 #include <cerrno>
+#include <cinttypes>
 #include <filesystem>
 #include <regex>
+#include <set>
 #include <string>
+#include <vector>
 
 #include "CodeWriter.h"
 #include "Common.h"
@@ -37,13 +41,8 @@ namespace {
 
 constexpr const char* kIndent = "    ";
 
-constexpr const char* kCppHeaderIncludes =
-    R"(#include <cstdint>
-#include <optional>
-#include <string>
-#include <vector>
-
-)";
+constexpr const char* kCppHeaderIncludes[] = {"cstdint", "optional", "string",
+                                              "vector"};
 
 constexpr const char* kCppSourceIncludes =
     R"(#include <cctype>
@@ -61,58 +60,109 @@ constexpr const char* kCppSourceIncludes =
 
 )";
 
-constexpr const char* kCppParsersAndFormatters =
-    R"(template <typename T> constexpr bool is_vector = false;
 
-template <typename T> constexpr bool is_vector<std::vector<T>> = true;
+// Helpers for primitive types. GenerateSource only emits the ones which are
+// actually used by the module, so that no templates have to be instantiated
+// while compiling generated sources.
+struct PrimitiveHelpers {
+  sysprop::Type type;
+  const char* parser;
+  const char* formatter;
+};
 
-template <> [[maybe_unused]] std::optional<bool> DoParse(const char* str) {
+constexpr const PrimitiveHelpers kCppPrimitiveHelpers[] = {
+    {sysprop::Boolean,
+     R"(void DoParse(const char* str, std::optional<bool>* out) {
     static constexpr const char* kYes[] = {"1", "true"};
     static constexpr const char* kNo[] = {"0", "false"};
 
     for (const char* yes : kYes) {
-        if (strcasecmp(yes, str) == 0) return std::make_optional(true);
+        if (strcasecmp(yes, str) == 0) {
+            *out = true;
+            return;
+        }
     }
 
     for (const char* no : kNo) {
-        if (strcasecmp(no, str) == 0) return std::make_optional(false);
+        if (strcasecmp(no, str) == 0) {
+            *out = false;
+            return;
+        }
     }
 
-    return std::nullopt;
+    *out = std::nullopt;
 }
 
-template <> [[maybe_unused]] std::optional<std::int32_t> DoParse(const char* str) {
+)",
+     R"(std::string FormatValue(const std::optional<bool>& value) {
+    return value ? (*value ? "true" : "false") : "";
+}
+
+)"},
+    {sysprop::Integer,
+     R"(void DoParse(const char* str, std::optional<std::int32_t>* out) {
     std::int32_t ret;
-    return android::base::ParseInt(str, &ret) ? std::make_optional(ret) : std::nullopt;
+    *out = android::base::ParseInt(str, &ret) ? std::make_optional(ret) : std::nullopt;
+}
+
+)",
+     R"(std::string FormatValue(const std::optional<std::int32_t>& value) {
+    return value ? std::to_string(*value) : "";
 }
 
-template <> [[maybe_unused]] std::optional<std::int64_t> DoParse(const char* str) {
+)"},
+    {sysprop::Long,
+     R"(void DoParse(const char* str, std::optional<std::int64_t>* out) {
     std::int64_t ret;
-    return android::base::ParseInt(str, &ret) ? std::make_optional(ret) : std::nullopt;
+    *out = android::base::ParseInt(str, &ret) ? std::make_optional(ret) : std::nullopt;
+}
+
+)",
+     R"(std::string FormatValue(const std::optional<std::int64_t>& value) {
+    return value ? std::to_string(*value) : "";
 }
 
-template <> [[maybe_unused]] std::optional<double> DoParse(const char* str) {
+)"},
+    {sysprop::Double,
+     R"(void DoParse(const char* str, std::optional<double>* out) {
     int old_errno = errno;
     errno = 0;
     char* end;
     double ret = std::strtod(str, &end);
     if (errno != 0) {
-        return std::nullopt;
+        *out = std::nullopt;
+        return;
     }
     if (str == end || *end != '\0') {
         errno = EINVAL;
-        return std::nullopt;
+        *out = std::nullopt;
+        return;
     }
     errno = old_errno;
-    return std::make_optional(ret);
+    *out = ret;
+}
+
+)",
+     R"(std::string FormatValue(const std::optional<double>& value) {
+    if (!value) return "";
+    char buf[1024];
+    std::sprintf(buf, "%.*g", std::numeric_limits<double>::max_digits10, *value);
+    return buf;
 }
 
-template <> [[maybe_unused]] std::optional<std::string> DoParse(const char* str) {
-    return *str == '\0' ? std::nullopt : std::make_optional(str);
+)"},
+    {sysprop::String,
+     R"(void DoParse(const char* str, std::optional<std::string>* out) {
+    *out = *str == '\0' ? std::nullopt : std::make_optional(str);
 }
 
-template <typename Vec> [[maybe_unused]] Vec DoParseList(const char* str) {
-    Vec ret;
+)",
+     nullptr},
+};
+
+constexpr const char* kCppSplitListValue =
+    R"(std::vector<std::string> SplitListValue(const char* str) {
+    std::vector<std::string> ret;
     if (*str == '\0') return ret;
     const char* p = str;
     for (;;) {
@@ -123,168 +173,1966 @@ template <typename Vec> [[maybe_unused]] Vec DoParseList(const char* str) {
             if (*r == '\0') break;
             value += *r++;
         }
-        ret.emplace_back(DoParse<typename Vec::value_type>(value.c_str()));
+        ret.emplace_back(std::move(value));
         if (*r == '\0') break;
         p = r + 1;
     }
     return ret;
 }
 
-template <typename T> inline T TryParse(const char* str) {
-    if constexpr(is_vector<T>) {
-        return DoParseList<T>(str);
-    } else {
-        return DoParse<T>(str);
+)";
+
+// Map properties are encoded as "key=value,key=value", with '\\', ',' and '='
+// in keys and values escaped by a backslash. The map keeps all keys in one
+// buffer, sorted, so that lookups are binary searches over a single parse.
+constexpr const char* kCppFlatMap =
+    R"(#ifndef SYSPROP_FLAT_MAP_DEFINED
+#define SYSPROP_FLAT_MAP_DEFINED
+
+namespace sysprop {
+
+template <typename T>
+class FlatMap {
+  public:
+    std::size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+
+    std::string_view key(std::size_t index) const {
+        const Entry& entry = entries_[index];
+        return std::string_view(keys_).substr(entry.key_offset, entry.key_size);
+    }
+
+    const std::optional<T>& value(std::size_t index) const { return entries_[index].value; }
+
+    const std::optional<T>* find(std::string_view key) const {
+        std::size_t index = LowerBound(key);
+        if (index == entries_.size() || this->key(index) != key) return nullptr;
+        return &entries_[index].value;
+    }
+
+    bool contains(std::string_view key) const { return find(key) != nullptr; }
+
+    void insert(std::string_view key, std::optional<T> value) {
+        std::size_t index = LowerBound(key);
+        if (index < entries_.size() && this->key(index) == key) {
+            entries_[index].value = std::move(value);
+            return;
+        }
+        Entry entry{keys_.size(), key.size(), std::move(value)};
+        keys_.append(key);
+        entries_.insert(entries_.begin() + index, std::move(entry));
+    }
+
+  private:
+    struct Entry {
+        std::size_t key_offset;
+        std::size_t key_size;
+        std::optional<T> value;
+    };
+
+    std::size_t LowerBound(std::string_view key) const {
+        // Values written by FormatValue are sorted, so appending is the common case.
+        if (entries_.empty() || this->key(entries_.size() - 1) < key) return entries_.size();
+        std::size_t lo = 0;
+        std::size_t hi = entries_.size();
+        while (lo < hi) {
+            std::size_t mid = lo + (hi - lo) / 2;
+            if (this->key(mid) < key) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    std::string keys_;
+    std::vector<Entry> entries_;
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_FLAT_MAP_DEFINED
+
+)";
+
+// Flag sets of EnumList properties with at most 64 values, so that membership
+// tests don't have to scan a list.
+constexpr const char* kCppEnumFlags =
+    R"(#ifndef SYSPROP_ENUM_FLAGS_DEFINED
+#define SYSPROP_ENUM_FLAGS_DEFINED
+
+namespace sysprop {
+
+template <typename E>
+class EnumFlags {
+  public:
+    constexpr EnumFlags() = default;
+    constexpr explicit EnumFlags(std::uint64_t bits) : bits_(bits) {}
+    constexpr EnumFlags(std::initializer_list<E> values) {
+        for (E value : values) set(value);
+    }
+
+    constexpr bool test(E value) const { return (bits_ & Bit(value)) != 0; }
+    constexpr bool any() const { return bits_ != 0; }
+    constexpr bool none() const { return bits_ == 0; }
+    constexpr std::uint64_t bits() const { return bits_; }
+
+    constexpr EnumFlags& set(E value, bool on = true) {
+        bits_ = on ? (bits_ | Bit(value)) : (bits_ & ~Bit(value));
+        return *this;
+    }
+
+    constexpr EnumFlags& reset(E value) { return set(value, false); }
+
+    constexpr bool operator==(const EnumFlags& other) const { return bits_ == other.bits_; }
+    constexpr bool operator!=(const EnumFlags& other) const { return bits_ != other.bits_; }
+
+  private:
+    static constexpr std::uint64_t Bit(E value) {
+        return std::uint64_t{1} << static_cast<std::uint32_t>(value);
+    }
+
+    std::uint64_t bits_ = 0;
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_ENUM_FLAGS_DEFINED
+
+)";
+
+// Integer constants formatted at compile time, for constant setters.
+constexpr const char* kCppIntegerString =
+    R"(#ifndef SYSPROP_INTEGER_STRING_DEFINED
+#define SYSPROP_INTEGER_STRING_DEFINED
+
+namespace sysprop {
+
+template <std::int64_t kValue>
+struct IntegerString {
+    static constexpr std::size_t Size() {
+        std::size_t size = kValue <= 0 ? 1 : 0;
+        for (std::int64_t v = kValue; v != 0; v /= 10) ++size;
+        return size;
+    }
+
+    static constexpr std::array<char, Size() + 1> Format() {
+        std::array<char, Size() + 1> ret{};
+        std::int64_t v = kValue;
+        std::size_t i = Size();
+        do {
+            int digit = static_cast<int>(v % 10);
+            ret[--i] = static_cast<char>('0' + (digit < 0 ? -digit : digit));
+            v /= 10;
+        } while (v != 0);
+        if (kValue < 0) ret[0] = '-';
+        return ret;
+    }
+
+    static constexpr std::array<char, Size() + 1> value = Format();
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_INTEGER_STRING_DEFINED
+
+)";
+
+constexpr const char* kCppAppendMapToken =
+    R"(void AppendMapToken(std::string* ret, std::string_view token) {
+    for (char c : token) {
+        if (c == '\\' || c == ',' || c == '=') *ret += '\\';
+        *ret += c;
     }
 }
 
-[[maybe_unused]] std::string FormatValue(const std::optional<std::int32_t>& value) {
-    return value ? std::to_string(*value) : "";
+)";
+
+constexpr const char* kCppTableEnumConverters =
+    R"(template <typename E>
+inline std::optional<E> ToEnum(const std::optional<std::int32_t>& value) {
+    return value ? std::make_optional(static_cast<E>(*value)) : std::nullopt;
 }
 
-[[maybe_unused]] std::string FormatValue(const std::optional<std::int64_t>& value) {
-    return value ? std::to_string(*value) : "";
+template <typename E>
+inline std::vector<std::optional<E>> ToEnum(const std::vector<std::optional<std::int32_t>>& value) {
+    std::vector<std::optional<E>> ret;
+    ret.reserve(value.size());
+    for (auto&& element : value) ret.push_back(ToEnum<E>(element));
+    return ret;
 }
 
-[[maybe_unused]] std::string FormatValue(const std::optional<double>& value) {
-    if (!value) return "";
-    char buf[1024];
-    std::sprintf(buf, "%.*g", std::numeric_limits<double>::max_digits10, *value);
-    return buf;
+template <typename E>
+inline std::optional<std::int32_t> FromEnum(const std::optional<E>& value) {
+    return value ? std::make_optional(static_cast<std::int32_t>(*value)) : std::nullopt;
 }
 
-[[maybe_unused]] std::string FormatValue(const std::optional<bool>& value) {
-    return value ? (*value ? "true" : "false") : "";
+template <typename E>
+inline std::vector<std::optional<std::int32_t>> FromEnum(const std::vector<std::optional<E>>& value) {
+    std::vector<std::optional<std::int32_t>> ret;
+    ret.reserve(value.size());
+    for (auto&& element : value) ret.push_back(FromEnum(element));
+    return ret;
 }
+)";
 
-template <typename T>
-[[maybe_unused]] std::string FormatValue(const std::vector<T>& value) {
-    if (value.empty()) return "";
+constexpr const char* kCppTablePropDescriptor =
+    R"(constexpr std::uint8_t kIntegerAsBool = 1 << 0;
+
+struct PropDescriptor {
+    std::uint32_t name_offset;
+    std::uint32_t name_hash;
+    std::uint16_t enum_table;
+    PropType type;
+    std::uint8_t flags;
+};
+
+struct EnumTable {
+    std::uint32_t first;
+    std::uint32_t count;
+};
+
+)";
+
+constexpr const char* kCppTableKeyComment =
+    R"(// Accessors take the index of the property in the source, with the hash of its
+// name in the upper 32 bits. The source aborts on keys which don't match, so
+// this header and all code including it must be rebuilt whenever the sysprop
+// file changes.
+)";
+
+constexpr const char* kCppTableGetPropName =
+    R"(std::uint32_t GetPropIndex(std::uint64_t key) {
+    std::uint32_t index = static_cast<std::uint32_t>(key);
+    LOG_ALWAYS_FATAL_IF(index >= sizeof(kProps) / sizeof(kProps[0]) || kProps[index].name_hash != key >> 32,
+                        "Invalid property key %llx", static_cast<unsigned long long>(key));
+    return index;
+}
+
+const char* GetPropName(std::uint32_t index, PropType type) {
+    LOG_ALWAYS_FATAL_IF(kProps[index].type != type, "Invalid property index %u for type %d", index, type);
+    return kPropNames + kProps[index].name_offset;
+}
 
+)";
+
+constexpr const char* kCppTableEnumHelpers =
+    R"(std::optional<std::int32_t> ParseEnum(std::uint16_t table, const std::optional<std::string>& value) {
+    if (!value) return std::nullopt;
+    const EnumTable& enum_table = kEnumTables[table];
+    for (std::uint32_t i = 0; i < enum_table.count; ++i) {
+        if (*value == kEnumValueNames + kEnumValueOffsets[enum_table.first + i]) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+)";
+
+constexpr const char* kCppTableEnumFormatter =
+    R"(const char* FormatEnum(std::uint16_t table, std::int32_t value, const char* name) {
+    const EnumTable& enum_table = kEnumTables[table];
+    LOG_ALWAYS_FATAL_IF(value < 0 || static_cast<std::uint32_t>(value) >= enum_table.count,
+                        "Invalid value %d for property %s", value, name);
+    return kEnumValueNames + kEnumValueOffsets[enum_table.first + value];
+}
+
+)";
+
+constexpr const char* kCppTableEnumListFormatter =
+    R"(std::string FormatEnumList(std::uint16_t table, const std::vector<std::optional<std::int32_t>>& value,
+                           const char* name) {
     std::string ret;
     bool first = true;
 
     for (auto&& element : value) {
         if (!first) ret += ',';
         else first = false;
-        if constexpr(std::is_same_v<T, std::optional<std::string>>) {
-            if (element) {
-                for (char c : *element) {
-                    if (c == '\\' || c == ',') ret += '\\';
-                    ret += c;
-                }
+        if (element) ret += FormatEnum(table, *element, name);
+    }
+
+    return ret;
+}
+
+)";
+
+constexpr const char* kCppTableEnumFlagsHelpers =
+    R"(std::uint64_t ParseEnumFlags(std::uint16_t table, const char* str) {
+    const EnumTable& enum_table = kEnumTables[table];
+    std::uint64_t ret = 0;
+    while (*str != '\0') {
+        const char* end = std::strchr(str, ',');
+        std::size_t size = end != nullptr ? end - str : std::strlen(str);
+        for (std::uint32_t i = 0; i < enum_table.count; ++i) {
+            const char* name = kEnumValueNames + kEnumValueOffsets[enum_table.first + i];
+            if (std::strncmp(str, name, size) == 0 && name[size] == '\0') {
+                ret |= std::uint64_t{1} << i;
+                break;
             }
-        } else {
-            ret += FormatValue(element);
         }
+        if (end == nullptr) break;
+        str = end + 1;
     }
+    return ret;
+}
+
+)";
 
+constexpr const char* kCppTableEnumFlagsFormatter =
+    R"(std::string FormatEnumFlags(std::uint16_t table, std::uint64_t value) {
+    const EnumTable& enum_table = kEnumTables[table];
+    std::string ret;
+    for (std::uint32_t i = 0; i < enum_table.count; ++i) {
+        if ((value & (std::uint64_t{1} << i)) == 0) continue;
+        if (!ret.empty()) ret += ',';
+        ret += kEnumValueNames + kEnumValueOffsets[enum_table.first + i];
+    }
     return ret;
 }
 
-template <typename T>
-T GetProp(const char* key) {
-    T ret;
-    auto pi = __system_property_find(key);
+)";
+
+// Instrumentation: each getter records the serials it observes into a ring
+// buffer per property. Records are written lock-free, and a record's sequence
+// number is reset while it's being written so that readers can skip it.
+constexpr const char* kCppChangeHistory =
+    R"(constexpr std::size_t kChangeHistorySize = 16;
+
+struct ChangeRecord {
+    std::atomic<std::uint64_t> sequence;
+    std::atomic<std::uint64_t> timestamp_ns;
+    std::atomic<std::uint32_t> serial;
+    std::atomic<std::uint32_t> value_hash;
+};
+
+struct ChangeHistory {
+    std::atomic<std::uint32_t> last_serial;
+    std::atomic<std::uint64_t> count;
+    ChangeRecord records[kChangeHistorySize];
+};
+
+std::uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::uint32_t HashValue(const char* value) {
+    std::uint32_t hash = 2166136261u;
+    for (; *value != '\0'; ++value) {
+        hash = (hash ^ static_cast<unsigned char>(*value)) * 16777619u;
+    }
+    return hash;
+}
+
+// Serials keep the value length in their top 8 bits and a counter in the
+// low 24 bits, so they're ordered by the counter, allowing for wraparound.
+bool IsNewerSerial(std::uint32_t serial, std::uint32_t last) {
+    return static_cast<std::int32_t>((serial - last) << 8) > 0;
+}
+
+// The first observation only sets the baseline. Readers which raced with a
+// newer observation drop theirs, so stale values are never recorded.
+void RecordChange(ChangeHistory* history, std::uint32_t serial, const char* value) {
+    std::uint32_t last = history->last_serial.load(std::memory_order_relaxed);
+    do {
+        if (last != 0 && !IsNewerSerial(serial, last)) return;
+    } while (!history->last_serial.compare_exchange_weak(last, serial, std::memory_order_relaxed));
+    if (last == 0) return;
+
+    std::uint64_t index = history->count.fetch_add(1, std::memory_order_relaxed);
+    ChangeRecord& record = history->records[index % kChangeHistorySize];
+    record.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    record.timestamp_ns.store(NowNs(), std::memory_order_relaxed);
+    record.serial.store(serial, std::memory_order_relaxed);
+    record.value_hash.store(HashValue(value), std::memory_order_relaxed);
+    record.sequence.store(index + 1, std::memory_order_release);
+}
+
+PropChangeStats CollectChangeStats(const char* name, const ChangeHistory& history,
+                                   std::uint64_t now, std::uint64_t window_ns) {
+    PropChangeStats stats{name, history.count.load(std::memory_order_relaxed), 0, 0, 0.0};
+    std::uint32_t hashes[kChangeHistorySize];
+    std::uint64_t oldest_ns = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t newest_ns = 0;
+
+    for (const ChangeRecord& record : history.records) {
+        std::uint64_t sequence = record.sequence.load(std::memory_order_acquire);
+        std::uint64_t timestamp_ns = record.timestamp_ns.load(std::memory_order_relaxed);
+        std::uint32_t value_hash = record.value_hash.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence == 0 || record.sequence.load(std::memory_order_relaxed) != sequence) continue;
+        // Records written after now was taken are in the window too.
+        if (timestamp_ns < now && now - timestamp_ns > window_ns) continue;
+
+        bool seen = false;
+        for (std::uint32_t i = 0; i < stats.recent_changes; ++i) {
+            if (hashes[i] == value_hash) seen = true;
+        }
+        if (!seen) ++stats.recent_values;
+        hashes[stats.recent_changes++] = value_hash;
+        oldest_ns = std::min(oldest_ns, timestamp_ns);
+        newest_ns = std::max(newest_ns, timestamp_ns);
+    }
+
+    // When every record is in the window and older ones were overwritten, the
+    // window holds more changes than were kept, so the rate is taken over the
+    // span of the records instead.
+    if (stats.recent_changes == kChangeHistorySize && stats.total_changes > kChangeHistorySize &&
+        newest_ns > oldest_ns) {
+        stats.changes_per_second = (stats.recent_changes - 1) * 1e9 / (newest_ns - oldest_ns);
+    } else if (std::min(window_ns, now) > 0) {
+        // The window can't reach back past the epoch of the steady clock, so
+        // larger windows average over the time since then instead.
+        stats.changes_per_second = stats.recent_changes * 1e9 / std::min(window_ns, now);
+    }
+    return stats;
+}
+
+)";
+
+constexpr const char* kCppChangeStatsDeclaration =
+    R"(// Property changes observed by getters in this process. total_changes counts
+// every change since the process started. At most 16 recent changes are kept
+// per property; recent_values counts the distinct values among them, so a
+// flapping property has many changes but few values. changes_per_second is
+// averaged over the window, or over the span of the kept changes when older
+// changes in the window were dropped.
+struct PropChangeStats {
+    const char* prop_name;
+    std::uint64_t total_changes;
+    std::uint32_t recent_changes;
+    std::uint32_t recent_values;
+    double changes_per_second;
+};
+
+// Pass std::numeric_limits<std::uint64_t>::max() as window_ns for all of the
+// recent changes which are kept.
+std::vector<PropChangeStats> GetPropChangeStats(std::uint64_t window_ns);
+)";
+
+// Module registry: getters read through the handle table which the module
+// registers with libsysprop_registry. Reads which skipped a lookup are only
+// counted in instrumented modules, to keep a shared atomic off the hot path.
+constexpr const char* kCppFindProp =
+    R"(const prop_info* FindProp(std::uint32_t index, const char* name) {
+    const prop_info* pi = gPropHandles[index].load(std::memory_order_acquire);
+    if (pi != nullptr) return pi;
+    pi = __system_property_find(name);
+    if (pi != nullptr) gPropHandles[index].store(pi, std::memory_order_release);
+    return pi;
+}
+
+)";
+
+constexpr const char* kCppFindPropCounted =
+    R"(const prop_info* FindProp(std::uint32_t index, const char* name) {
+    const prop_info* pi = gPropHandles[index].load(std::memory_order_acquire);
     if (pi != nullptr) {
-        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
-            *static_cast<T*>(cookie) = TryParse<T>(value);
-        }, &ret);
+        gSavedLookups.fetch_add(1, std::memory_order_relaxed);
+        return pi;
     }
-    return ret;
+    pi = __system_property_find(name);
+    if (pi != nullptr) gPropHandles[index].store(pi, std::memory_order_release);
+    return pi;
+}
+
+)";
+
+// Profiled getters keep the handles of their properties. Properties are
+// never removed, so a handle stays valid once it has been found.
+constexpr const char* kCppFindCachedProp =
+    R"(const prop_info* FindCachedProp(std::atomic<const prop_info*>* handle, const char* name) {
+    const prop_info* pi = handle->load(std::memory_order_acquire);
+    if (pi == nullptr) {
+        pi = __system_property_find(name);
+        if (pi != nullptr) handle->store(pi, std::memory_order_release);
+    }
+    return pi;
+}
+
+)";
+
+// Serial caches keep the last value read with the serial it was read at, so
+// that readers only parse a property after it changed. Readers copy the value
+// without locking, and check the sequence number around the copy, which is
+// odd while the value is refilled. Readers which race with a refill read the
+// property themselves. The lock only serializes refills.
+constexpr const char* kCppSerialCache =
+    R"(struct SerialCache {
+    std::mutex lock;
+    std::atomic<std::uint64_t> sequence;
+    std::atomic<std::uint32_t> serial;
+    std::atomic<std::uint64_t> words[2];
+};
+
+bool LoadCached(SerialCache* cache, std::uint32_t serial, void* value, std::size_t size) {
+    std::uint64_t sequence = cache->sequence.load(std::memory_order_acquire);
+    if (sequence == 0 || sequence % 2 != 0) return false;
+    if (cache->serial.load(std::memory_order_relaxed) != serial) return false;
+    std::uint64_t words[2] = {cache->words[0].load(std::memory_order_relaxed),
+                              cache->words[1].load(std::memory_order_relaxed)};
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (cache->sequence.load(std::memory_order_relaxed) != sequence) return false;
+    std::memcpy(value, words, size);
+    return true;
+}
+
+void StoreCached(SerialCache* cache, std::uint32_t serial, const void* value, std::size_t size) {
+    std::uint64_t words[2] = {};
+    std::memcpy(words, value, size);
+    std::lock_guard<std::mutex> guard(cache->lock);
+    std::uint64_t sequence = cache->sequence.load(std::memory_order_relaxed);
+    cache->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    cache->serial.store(serial, std::memory_order_relaxed);
+    cache->words[0].store(words[0], std::memory_order_relaxed);
+    cache->words[1].store(words[1], std::memory_order_relaxed);
+    cache->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+)";
+
+// Snapshots: "SYSP", a varint format version, the schema hash as a
+// little-endian 64-bit integer, and then every property value in order.
+// Optional values start with a presence byte, integers are zigzag varints,
+// enums are varint ordinals, and lists and maps are prefixed by their sizes.
+constexpr const char* kCppSnapshotBase =
+    R"(constexpr std::uint64_t kSnapshotVersion = 1;
+
+void PutVarint(std::string* out, std::uint64_t value) {
+    while (value >= 0x80) {
+        *out += static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    *out += static_cast<char>(value);
+}
+
+bool GetVarint(std::string_view* in, std::uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (in->empty()) return false;
+        std::uint8_t byte = in->front();
+        in->remove_prefix(1);
+        *value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+void PutFixed64(std::string* out, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) *out += static_cast<char>(value >> (i * 8));
+}
+
+bool GetFixed64(std::string_view* in, std::uint64_t* value) {
+    if (in->size() < 8) return false;
+    *value = 0;
+    for (int i = 0; i < 8; ++i) {
+        *value |= static_cast<std::uint64_t>(static_cast<std::uint8_t>((*in)[i])) << (i * 8);
+    }
+    in->remove_prefix(8);
+    return true;
+}
+
+bool GetPresence(std::string_view* in, bool* present) {
+    std::uint64_t raw;
+    if (!GetVarint(in, &raw) || raw > 1) return false;
+    *present = raw == 1;
+    return true;
 }
 
 )";
 
+struct SnapshotHelpers {
+  sysprop::Type type;
+  const char* payload;
+};
+
+constexpr const SnapshotHelpers kCppSnapshotPayloads[] = {
+    {sysprop::Boolean,
+     R"(void PutPayload(std::string* out, bool value) {
+    *out += static_cast<char>(value);
+}
+
+bool GetPayload(std::string_view* in, bool* value) {
+    std::uint64_t raw;
+    if (!GetVarint(in, &raw) || raw > 1) return false;
+    *value = raw == 1;
+    return true;
+}
+
+)"},
+    {sysprop::Integer,
+     R"(void PutPayload(std::string* out, std::int32_t value) {
+    PutVarint(out, (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31));
+}
+
+bool GetPayload(std::string_view* in, std::int32_t* value) {
+    std::uint64_t raw;
+    if (!GetVarint(in, &raw) || raw > std::numeric_limits<std::uint32_t>::max()) return false;
+    *value = static_cast<std::int32_t>((raw >> 1) ^ (~(raw & 1) + 1));
+    return true;
+}
+
+)"},
+    {sysprop::Long,
+     R"(void PutPayload(std::string* out, std::int64_t value) {
+    PutVarint(out, (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+}
+
+bool GetPayload(std::string_view* in, std::int64_t* value) {
+    std::uint64_t raw;
+    if (!GetVarint(in, &raw)) return false;
+    *value = static_cast<std::int64_t>((raw >> 1) ^ (~(raw & 1) + 1));
+    return true;
+}
+
+)"},
+    {sysprop::Double,
+     R"(void PutPayload(std::string* out, double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    PutFixed64(out, bits);
+}
+
+bool GetPayload(std::string_view* in, double* value) {
+    std::uint64_t bits;
+    if (!GetFixed64(in, &bits)) return false;
+    std::memcpy(value, &bits, sizeof(bits));
+    return true;
+}
+
+)"},
+    {sysprop::String,
+     R"(void PutPayload(std::string* out, const std::string& value) {
+    PutVarint(out, value.size());
+    *out += value;
+}
+
+bool GetPayload(std::string_view* in, std::string* value) {
+    std::uint64_t size;
+    if (!GetVarint(in, &size) || size > in->size()) return false;
+    value->assign(in->data(), size);
+    in->remove_prefix(size);
+    return true;
+}
+
+)"},
+};
+
 const std::regex kRegexDot{"\\."};
 const std::regex kRegexUnderscore{"_"};
 
 std::string GetCppEnumName(const sysprop::Property& prop);
+std::string GetCppStructName(const sysprop::Property& prop);
+std::string GetCppStructFieldEnumName(const sysprop::StructField& field);
+sysprop::Type GetElementType(const sysprop::Property& prop);
+std::string GetCppScalarTypeName(sysprop::Type type);
+std::string GetCppPrimitiveTypeName(sysprop::Type type);
+std::string GetCppMapTypeName(sysprop::Type type);
+std::string GetCppElementTypeName(const sysprop::Property& prop);
+std::string GetCppStructFieldTypeName(const sysprop::StructField& field);
 std::string GetCppPropTypeName(const sysprop::Property& prop);
+std::string GetCppEnumFlagsTypeName(const sysprop::Property& prop);
 std::string GetCppNamespace(const sysprop::Properties& props);
 
+// Types used by a module, which decide the helpers GenerateSource emits.
+struct UsedTypes {
+  std::set<sysprop::Type> parsed;
+  std::set<sysprop::Type> formatted;
+  std::vector<std::string> list_parsers;
+  std::vector<std::string> list_formatters;
+  std::vector<sysprop::Type> map_parsers;
+  std::vector<sysprop::Type> map_formatters;
+  std::vector<std::string> getters;
+  std::vector<const sysprop::Property*> structs;
+  bool split_list_value = false;
+  std::set<std::string> seen;
+};
+
+void CollectUsedTypes(const sysprop::Property& prop, UsedTypes* used);
+void WriteHelpers(CodeWriter& writer, const UsedTypes& used,
+                  const CppGenOptions& options, bool by_handle);
+void WriteEnumHelpers(CodeWriter& writer, const std::string& list_name,
+                      const std::string& enum_name,
+                      const std::string& enum_values,
+                      const std::string& prop_name, bool writable);
+void WritePropEnumHelpers(CodeWriter& writer, const sysprop::Property& prop);
+void WriteStructHelpers(CodeWriter& writer, const sysprop::Property& prop);
+void WriteEnumFlagsHelpers(CodeWriter& writer, const sysprop::Property& prop);
+void WriteStructDeclaration(CodeWriter& writer, const sysprop::Property& prop);
+std::string GetFormattingExpression(const sysprop::Property& prop);
+void WriteEnumDeclaration(CodeWriter& writer, const sysprop::Property& prop);
+bool HasConstantSetter(const sysprop::Property& prop);
+void WriteConstantSetter(CodeWriter& writer, const sysprop::Property& prop,
+                         const std::string& table_key);
+std::string GetTableAccessorType(const sysprop::Property& prop);
+std::string GetTableAccessorName(const sysprop::Property& prop);
+void WriteTableAccessorDeclarations(CodeWriter& writer,
+                                    const sysprop::Properties& props,
+                                    sysprop::Scope scope);
+void WriteTableAccessors(CodeWriter& writer, const sysprop::Property& prop,
+                         int index);
+
 std::string GenerateHeader(const sysprop::Properties& props,
-                           sysprop::Scope scope);
+                           sysprop::Scope scope, const CppGenOptions& options);
+void WriteChangeHistories(CodeWriter& writer,
+                          const sysprop::Properties& props);
+void WriteGetPropChangeStats(CodeWriter& writer,
+                             const sysprop::Properties& props);
+void WriteModuleRegistration(CodeWriter& writer,
+                             const sysprop::Properties& props,
+                             const CppGenOptions& options);
+std::uint64_t GetSnapshotSchemaHash(const sysprop::Properties& props);
+void WriteSnapshotDeclaration(CodeWriter& writer,
+                              const sysprop::Properties& props);
+void WriteSnapshotHelpers(CodeWriter& writer,
+                          const sysprop::Properties& props);
+void WriteSnapshotFunctions(CodeWriter& writer,
+                            const sysprop::Properties& props);
+void WriteSourceExtraIncludes(CodeWriter& writer, const CppGenOptions& options,
+                              const std::vector<PropAccess>& accesses);
+void WriteGetterBody(CodeWriter& writer, const sysprop::Property& prop,
+                     int index, AccessStrategy strategy,
+                     const std::string& prop_type,
+                     const CppGenOptions& options, bool by_handle);
 std::string GenerateSource(const sysprop::Properties& props,
-                           const std::string& include_name);
+                           const std::string& include_name,
+                           const CppGenOptions& options,
+                           const std::vector<PropAccess>& accesses);
+std::string GenerateTableDrivenSource(const sysprop::Properties& props,
+                                      const std::string& include_name,
+                                      const CppGenOptions& options);
 
 std::string GetCppEnumName(const sysprop::Property& prop) {
   return ApiNameToIdentifier(prop.api_name()) + "_values";
 }
 
-std::string GetCppPropTypeName(const sysprop::Property& prop) {
+std::string GetCppStructName(const sysprop::Property& prop) {
+  return ApiNameToIdentifier(prop.api_name()) + "_values";
+}
+
+// Enums of struct fields are nested in the struct.
+std::string GetCppStructFieldEnumName(const sysprop::StructField& field) {
+  return field.name() + "_values";
+}
+
+sysprop::Type GetElementType(const sysprop::Property& prop) {
   switch (prop.type()) {
-    case sysprop::Boolean:
-      return "std::optional<bool>";
-    case sysprop::Integer:
-      return "std::optional<std::int32_t>";
-    case sysprop::Long:
-      return "std::optional<std::int64_t>";
-    case sysprop::Double:
-      return "std::optional<double>";
-    case sysprop::String:
-      return "std::optional<std::string>";
-    case sysprop::Enum:
-      return "std::optional<" + GetCppEnumName(prop) + ">";
     case sysprop::BooleanList:
-      return "std::vector<std::optional<bool>>";
+      return sysprop::Boolean;
     case sysprop::IntegerList:
-      return "std::vector<std::optional<std::int32_t>>";
+      return sysprop::Integer;
     case sysprop::LongList:
-      return "std::vector<std::optional<std::int64_t>>";
+      return sysprop::Long;
     case sysprop::DoubleList:
-      return "std::vector<std::optional<double>>";
+      return sysprop::Double;
     case sysprop::StringList:
-      return "std::vector<std::optional<std::string>>";
+      return sysprop::String;
     case sysprop::EnumList:
-      return "std::vector<std::optional<" + GetCppEnumName(prop) + ">>";
+      return sysprop::Enum;
+    case sysprop::BooleanMap:
+      return sysprop::Boolean;
+    case sysprop::IntegerMap:
+      return sysprop::Integer;
+    case sysprop::LongMap:
+      return sysprop::Long;
+    case sysprop::DoubleMap:
+      return sysprop::Double;
+    case sysprop::StringMap:
+      return sysprop::String;
     default:
-      __builtin_unreachable();
+      return prop.type();
   }
 }
 
-std::string GetCppNamespace(const sysprop::Properties& props) {
-  return std::regex_replace(props.module(), kRegexDot, "::");
+std::string GetCppScalarTypeName(sysprop::Type type) {
+  switch (type) {
+    case sysprop::Boolean:
+      return "bool";
+    case sysprop::Integer:
+      return "std::int32_t";
+    case sysprop::Long:
+      return "std::int64_t";
+    case sysprop::Double:
+      return "double";
+    case sysprop::String:
+      return "std::string";
+    default:
+      __builtin_unreachable();
+  }
 }
 
-std::string GenerateHeader(const sysprop::Properties& props,
-                           sysprop::Scope scope) {
-  CodeWriter writer(kIndent);
+std::string GetCppPrimitiveTypeName(sysprop::Type type) {
+  return "std::optional<" + GetCppScalarTypeName(type) + ">";
+}
 
-  writer.Write("%s", kGeneratedFileFooterComments);
+std::string GetCppMapTypeName(sysprop::Type type) {
+  return "::sysprop::FlatMap<" + GetCppScalarTypeName(type) + ">";
+}
 
-  writer.Write("#pragma once\n\n");
-  writer.Write("%s", kCppHeaderIncludes);
+std::string GetCppElementTypeName(const sysprop::Property& prop) {
+  switch (GetElementType(prop)) {
+    case sysprop::Enum:
+      return "std::optional<" + GetCppEnumName(prop) + ">";
+    case sysprop::Struct:
+      return "std::optional<" + GetCppStructName(prop) + ">";
+    default:
+      return GetCppPrimitiveTypeName(GetElementType(prop));
+  }
+}
 
-  std::string cpp_namespace = GetCppNamespace(props);
-  writer.Write("namespace %s {\n\n", cpp_namespace.c_str());
+std::string GetCppStructFieldTypeName(const sysprop::StructField& field) {
+  if (field.type() == sysprop::Enum) {
+    return "std::optional<" + GetCppStructFieldEnumName(field) + ">";
+  }
+  return GetCppPrimitiveTypeName(field.type());
+}
 
-  bool first = true;
+std::string GetCppPropTypeName(const sysprop::Property& prop) {
+  if (IsMapProp(prop)) return GetCppMapTypeName(GetElementType(prop));
+  std::string element_type = GetCppElementTypeName(prop);
+  return IsListProp(prop) ? "std::vector<" + element_type + ">" : element_type;
+}
 
-  for (int i = 0; i < props.prop_size(); ++i) {
-    const sysprop::Property& prop = props.prop(i);
+std::string GetCppEnumFlagsTypeName(const sysprop::Property& prop) {
+  return "::sysprop::EnumFlags<" + GetCppEnumName(prop) + ">";
+}
 
-    // Scope: Internal > Public
-    if (prop.scope() > scope) continue;
+std::string GetCppNamespace(const sysprop::Properties& props) {
+  return std::regex_replace(props.module(), kRegexDot, "::");
+}
 
-    if (!first) {
-      writer.Write("\n");
-    } else {
-      first = false;
-    }
+void CollectUsedTypes(const sysprop::Property& prop, UsedTypes* used) {
+  std::string prop_type = GetCppPropTypeName(prop);
+  sysprop::Type element_type = GetElementType(prop);
+
+  if (element_type != sysprop::Enum && element_type != sysprop::Struct) {
+    used->parsed.insert(element_type);
+  }
+  if (used->seen.insert("get " + prop_type).second) {
+    used->getters.push_back(prop_type);
+  }
+  if (IsListProp(prop) && used->seen.insert("parse " + prop_type).second) {
+    used->list_parsers.push_back(prop_type);
+    used->split_list_value = true;
+  }
+  if (IsMapProp(prop) && used->seen.insert("parse " + prop_type).second) {
+    used->map_parsers.push_back(element_type);
+  }
+  if (HasEnumFlags(prop)) {
+    used->getters.push_back(GetCppEnumFlagsTypeName(prop));
+  }
+
+  if (prop.type() == sysprop::Struct) {
+    used->structs.push_back(&prop);
+    used->split_list_value = true;
+    for (const sysprop::StructField& field : prop.struct_fields()) {
+      if (field.type() == sysprop::Enum) continue;
+      used->parsed.insert(field.type());
+      if (prop.access() != sysprop::Readonly &&
+          field.type() != sysprop::String) {
+        used->formatted.insert(field.type());
+      }
+    }
+    return;
+  }
+
+  if (prop.access() == sysprop::Readonly) return;
+
+  if (prop.integer_as_bool()) {
+    // Boolean is formatted inline, and BooleanList is converted to
+    // IntegerList before formatting.
+    if (prop.type() == sysprop::BooleanList) {
+      std::string list_type = "std::vector<std::optional<std::int32_t>>";
+      used->formatted.insert(sysprop::Integer);
+      if (used->seen.insert("format " + list_type).second) {
+        used->list_formatters.push_back(list_type);
+      }
+    }
+    return;
+  }
+
+  if (element_type != sysprop::Enum && element_type != sysprop::String) {
+    used->formatted.insert(element_type);
+  }
+  if (IsListProp(prop) && used->seen.insert("format " + prop_type).second) {
+    used->list_formatters.push_back(prop_type);
+  }
+  if (IsMapProp(prop) && used->seen.insert("format " + prop_type).second) {
+    used->map_formatters.push_back(element_type);
+  }
+}
+
+void WriteHelpers(CodeWriter& writer, const UsedTypes& used,
+                  const CppGenOptions& options, bool by_handle) {
+  for (const PrimitiveHelpers& helpers : kCppPrimitiveHelpers) {
+    if (used.parsed.count(helpers.type) != 0) {
+      writer.Write("%s", helpers.parser);
+    }
+    if (used.formatted.count(helpers.type) != 0) {
+      writer.Write("%s", helpers.formatter);
+    }
+  }
+
+  if (used.split_list_value) writer.Write("%s", kCppSplitListValue);
+
+  for (const std::string& list_type : used.list_parsers) {
+    writer.Write("void DoParse(const char* str, %s* out) {\n",
+                 list_type.c_str());
+    writer.Indent();
+    writer.Write("for (const std::string& element : SplitListValue(str)) {\n");
+    writer.Indent();
+    writer.Write("DoParse(element.c_str(), &out->emplace_back());\n");
+    writer.Dedent();
+    writer.Write("}\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+  }
+
+  for (const std::string& list_type : used.list_formatters) {
+    writer.Write("std::string FormatValue(const %s& value) {\n",
+                 list_type.c_str());
+    writer.Indent();
+    writer.Write("std::string ret;\n");
+    writer.Write("bool first = true;\n\n");
+    writer.Write("for (auto&& element : value) {\n");
+    writer.Indent();
+    writer.Write("if (!first) ret += ',';\n");
+    writer.Write("else first = false;\n");
+    if (list_type == "std::vector<std::optional<std::string>>") {
+      writer.Write("if (element) {\n");
+      writer.Indent();
+      writer.Write("for (char c : *element) {\n");
+      writer.Indent();
+      writer.Write("if (c == '\\\\' || c == ',') ret += '\\\\';\n");
+      writer.Write("ret += c;\n");
+      writer.Dedent();
+      writer.Write("}\n");
+      writer.Dedent();
+      writer.Write("}\n");
+    } else {
+      writer.Write("ret += FormatValue(element);\n");
+    }
+    writer.Dedent();
+    writer.Write("}\n\n");
+    writer.Write("return ret;\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+  }
+
+  for (sysprop::Type value_type : used.map_parsers) {
+    writer.Write("void DoParse(const char* str, %s* out) {\n",
+                 GetCppMapTypeName(value_type).c_str());
+    writer.Indent();
+    writer.Write("std::string key;\n");
+    writer.Write("std::string value;\n");
+    writer.Write("const char* p = str;\n");
+    writer.Write("while (*p != '\\0') {\n");
+    writer.Indent();
+    writer.Write("key.clear();\n");
+    writer.Write("value.clear();\n");
+    writer.Write("std::string* token = &key;\n");
+    writer.Write("for (; *p != '\\0' && *p != ','; ++p) {\n");
+    writer.Indent();
+    writer.Write("if (*p == '=' && token == &key) {\n");
+    writer.Indent();
+    writer.Write("token = &value;\n");
+    writer.Write("continue;\n");
+    writer.Dedent();
+    writer.Write("}\n");
+    writer.Write("if (*p == '\\\\' && *(p + 1) != '\\0') ++p;\n");
+    writer.Write("*token += *p;\n");
+    writer.Dedent();
+    writer.Write("}\n");
+    writer.Write("if (*p == ',') ++p;\n");
+    writer.Write("%s parsed;\n", GetCppPrimitiveTypeName(value_type).c_str());
+    writer.Write("DoParse(value.c_str(), &parsed);\n");
+    writer.Write("out->insert(key, std::move(parsed));\n");
+    writer.Dedent();
+    writer.Write("}\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+  }
+
+  if (!used.map_formatters.empty()) writer.Write("%s", kCppAppendMapToken);
+
+  for (sysprop::Type value_type : used.map_formatters) {
+    writer.Write("std::string FormatValue(const %s& value) {\n",
+                 GetCppMapTypeName(value_type).c_str());
+    writer.Indent();
+    writer.Write("std::string ret;\n\n");
+    writer.Write("for (std::size_t i = 0; i < value.size(); ++i) {\n");
+    writer.Indent();
+    writer.Write("if (i > 0) ret += ',';\n");
+    writer.Write("AppendMapToken(&ret, value.key(i));\n");
+    writer.Write("ret += '=';\n");
+    if (value_type == sysprop::String) {
+      writer.Write(
+          "if (value.value(i)) AppendMapToken(&ret, *value.value(i));\n");
+    } else {
+      writer.Write("ret += FormatValue(value.value(i));\n");
+    }
+    writer.Dedent();
+    writer.Write("}\n\n");
+    writer.Write("return ret;\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+  }
+
+  for (const sysprop::Property* prop : used.structs) {
+    WriteStructHelpers(writer, *prop);
+  }
+
+  // With the module registry or profiled strategies, getters pass the handle
+  // instead of the name.
+  for (const std::string& prop_type : used.getters) {
+    writer.Write("void GetProp(%s, %s* value%s) {\n",
+                 by_handle ? "const prop_info* pi" : "const char* key",
+                 prop_type.c_str(),
+                 options.instrumented ? ", ChangeHistory* history" : "");
+    writer.Indent();
+    if (!by_handle) {
+      writer.Write("auto pi = __system_property_find(key);\n");
+    }
+    writer.Write("if (pi != nullptr) {\n");
+    writer.Indent();
+    if (options.instrumented) {
+      writer.Write("std::pair<%s*, ChangeHistory*> cookie(value, history);\n",
+                   prop_type.c_str());
+      writer.Write(
+          "__system_property_read_callback(pi, [](void* cookie, const char*, "
+          "const char* value, std::uint32_t serial) {\n");
+      writer.Indent();
+      writer.Write(
+          "auto [out, history] = *static_cast<std::pair<%s*, "
+          "ChangeHistory*>*>(cookie);\n",
+          prop_type.c_str());
+      writer.Write("RecordChange(history, serial, value);\n");
+      writer.Write("DoParse(value, out);\n");
+      writer.Dedent();
+      writer.Write("}, &cookie);\n");
+    } else {
+      writer.Write(
+          "__system_property_read_callback(pi, [](void* cookie, const char*, "
+          "const char* value, std::uint32_t) {\n");
+      writer.Indent();
+      writer.Write("DoParse(value, static_cast<%s*>(cookie));\n",
+                   prop_type.c_str());
+      writer.Dedent();
+      writer.Write("}, value);\n");
+    }
+    writer.Dedent();
+    writer.Write("}\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+  }
+}
+
+void WriteEnumHelpers(CodeWriter& writer, const std::string& list_name,
+                      const std::string& enum_name,
+                      const std::string& enum_values,
+                      const std::string& prop_name, bool writable) {
+  writer.Write("constexpr const std::pair<const char*, %s> %s[] = {\n",
+               enum_name.c_str(), list_name.c_str());
+  writer.Indent();
+  for (const std::string& name : android::base::Split(enum_values, "|")) {
+    writer.Write("{\"%s\", %s::%s},\n", name.c_str(), enum_name.c_str(),
+                 ToUpper(name).c_str());
+  }
+  writer.Dedent();
+  writer.Write("};\n\n");
+
+  writer.Write("void DoParse(const char* str, std::optional<%s>* out) {\n",
+               enum_name.c_str());
+  writer.Indent();
+  writer.Write("for (auto [name, val] : %s) {\n", list_name.c_str());
+  writer.Indent();
+  writer.Write("if (strcmp(str, name) == 0) {\n");
+  writer.Indent();
+  writer.Write("*out = val;\n");
+  writer.Write("return;\n");
+  writer.Dedent();
+  writer.Write("}\n");
+  writer.Dedent();
+  writer.Write("}\n");
+  writer.Write("*out = std::nullopt;\n");
+  writer.Dedent();
+  writer.Write("}\n\n");
+
+  if (writable) {
+    writer.Write("std::string FormatValue(std::optional<%s> value) {\n",
+                 enum_name.c_str());
+    writer.Indent();
+    writer.Write("if (!value) return \"\";\n");
+    writer.Write("for (auto [name, val] : %s) {\n", list_name.c_str());
+    writer.Indent();
+    writer.Write("if (val == *value) {\n");
+    writer.Indent();
+    writer.Write("return name;\n");
+    writer.Dedent();
+    writer.Write("}\n");
+    writer.Dedent();
+    writer.Write("}\n");
+
+    writer.Write(
+        "LOG_ALWAYS_FATAL(\"Invalid value %%d for property %s\", "
+        "static_cast<std::int32_t>(*value));\n",
+        prop_name.c_str());
+
+    writer.Write("__builtin_unreachable();\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+  }
+}
+
+void WritePropEnumHelpers(CodeWriter& writer, const sysprop::Property& prop) {
+  std::string prop_id = ApiNameToIdentifier(prop.api_name());
+  bool writable = prop.access() != sysprop::Readonly;
+
+  if (prop.type() == sysprop::Enum || prop.type() == sysprop::EnumList) {
+    WriteEnumHelpers(writer, prop_id + "_list", GetCppEnumName(prop),
+                     prop.enum_values(), prop.prop_name(), writable);
+    if (HasEnumFlags(prop)) WriteEnumFlagsHelpers(writer, prop);
+  } else if (prop.type() == sysprop::Struct) {
+    for (const sysprop::StructField& field : prop.struct_fields()) {
+      if (field.type() != sysprop::Enum) continue;
+      WriteEnumHelpers(
+          writer, prop_id + "_" + field.name() + "_list",
+          GetCppStructName(prop) + "::" + GetCppStructFieldEnumName(field),
+          field.enum_values(), prop.prop_name(), writable);
+    }
+  }
+}
+
+// Struct fields are encoded in one value in order, separated by commas and
+// escaped like list elements.
+void WriteStructHelpers(CodeWriter& writer, const sysprop::Property& prop) {
+  std::string struct_name = GetCppStructName(prop);
+  int field_count = prop.struct_fields_size();
+
+  writer.Write("void DoParse(const char* str, std::optional<%s>* out) {\n",
+               struct_name.c_str());
+  writer.Indent();
+  writer.Write("if (*str == '\\0') {\n");
+  writer.Indent();
+  writer.Write("*out = std::nullopt;\n");
+  writer.Write("return;\n");
+  writer.Dedent();
+  writer.Write("}\n");
+  writer.Write("std::vector<std::string> fields = SplitListValue(str);\n");
+  writer.Write("fields.resize(%d);\n", field_count);
+  writer.Write("%s& value = out->emplace();\n", struct_name.c_str());
+  for (int i = 0; i < field_count; ++i) {
+    writer.Write("DoParse(fields[%d].c_str(), &value.%s);\n", i,
+                 prop.struct_fields(i).name().c_str());
+  }
+  writer.Dedent();
+  writer.Write("}\n\n");
+
+  if (prop.access() == sysprop::Readonly) return;
+
+  writer.Write("std::string FormatValue(const std::optional<%s>& value) {\n",
+               struct_name.c_str());
+  writer.Indent();
+  writer.Write("if (!value) return \"\";\n");
+  writer.Write("std::string ret;\n");
+  for (int i = 0; i < field_count; ++i) {
+    const sysprop::StructField& field = prop.struct_fields(i);
+    if (i > 0) writer.Write("ret += ',';\n");
+    if (field.type() == sysprop::String) {
+      writer.Write("if (value->%s) {\n", field.name().c_str());
+      writer.Indent();
+      writer.Write("for (char c : *value->%s) {\n", field.name().c_str());
+      writer.Indent();
+      writer.Write("if (c == '\\\\' || c == ',') ret += '\\\\';\n");
+      writer.Write("ret += c;\n");
+      writer.Dedent();
+      writer.Write("}\n");
+      writer.Dedent();
+      writer.Write("}\n");
+    } else {
+      writer.Write("ret += FormatValue(value->%s);\n", field.name().c_str());
+    }
+  }
+  writer.Write("return ret;\n");
+  writer.Dedent();
+  writer.Write("}\n\n");
+}
+
+// Flag sets are parsed straight from the property value, without building
+// the list first. Unknown and empty elements are ignored.
+void WriteEnumFlagsHelpers(CodeWriter& writer, const sysprop::Property& prop) {
+  std::string list_name = ApiNameToIdentifier(prop.api_name()) + "_list";
+  std::string flags_type = GetCppEnumFlagsTypeName(prop);
+
+  writer.Write("void DoParse(const char* str, %s* out) {\n",
+               flags_type.c_str());
+  writer.Indent();
+  writer.Write("while (*str != '\\0') {\n");
+  writer.Indent();
+  writer.Write("const char* end = std::strchr(str, ',');\n");
+  writer.Write(
+      "std::size_t size = end != nullptr ? end - str : std::strlen(str);\n");
+  writer.Write("for (auto [name, val] : %s) {\n", list_name.c_str());
+  writer.Indent();
+  writer.Write(
+      "if (std::strncmp(str, name, size) == 0 && name[size] == '\\0') {\n");
+  writer.Indent();
+  writer.Write("out->set(val);\n");
+  writer.Write("break;\n");
+  writer.Dedent();
+  writer.Write("}\n");
+  writer.Dedent();
+  writer.Write("}\n");
+  writer.Write("if (end == nullptr) break;\n");
+  writer.Write("str = end + 1;\n");
+  writer.Dedent();
+  writer.Write("}\n");
+  writer.Dedent();
+  writer.Write("}\n\n");
+
+  if (prop.access() == sysprop::Readonly) return;
+
+  writer.Write("std::string FormatValue(const %s& value) {\n",
+               flags_type.c_str());
+  writer.Indent();
+  writer.Write("std::string ret;\n");
+  writer.Write("for (auto [name, val] : %s) {\n", list_name.c_str());
+  writer.Indent();
+  writer.Write("if (!value.test(val)) continue;\n");
+  writer.Write("if (!ret.empty()) ret += ',';\n");
+  writer.Write("ret += name;\n");
+  writer.Dedent();
+  writer.Write("}\n");
+  writer.Write("return ret;\n");
+  writer.Dedent();
+  writer.Write("}\n\n");
+}
+
+void WriteStructDeclaration(CodeWriter& writer,
+                            const sysprop::Property& prop) {
+  writer.Write("struct %s {\n", GetCppStructName(prop).c_str());
+  writer.Indent();
+  for (const sysprop::StructField& field : prop.struct_fields()) {
+    if (field.type() != sysprop::Enum) continue;
+    writer.Write("enum class %s {\n",
+                 GetCppStructFieldEnumName(field).c_str());
+    writer.Indent();
+    for (const std::string& name :
+         android::base::Split(field.enum_values(), "|")) {
+      writer.Write("%s,\n", ToUpper(name).c_str());
+    }
+    writer.Dedent();
+    writer.Write("};\n\n");
+  }
+  for (const sysprop::StructField& field : prop.struct_fields()) {
+    writer.Write("%s %s;\n", GetCppStructFieldTypeName(field).c_str(),
+                 field.name().c_str());
+  }
+  writer.Dedent();
+  writer.Write("};\n\n");
+}
+
+std::string GetFormattingExpression(const sysprop::Property& prop) {
+  if (prop.type() == sysprop::String) {
+    return "value ? value->c_str() : \"\"";
+  } else if (prop.integer_as_bool()) {
+    if (prop.type() == sysprop::Boolean) {
+      // optional<bool> -> "1" / "0"
+      return "value ? (*value ? \"1\" : \"0\") : \"\"";
+    } else if (prop.type() == sysprop::BooleanList) {
+      // vector<optional<bool>> -> vector<optional<int>>
+      return "FormatValue(std::vector<std::optional<std::int32_t>>("
+             "value.begin(), value.end())).c_str()";
+    }
+  }
+  return "FormatValue(value).c_str()";
+}
+
+void WriteEnumDeclaration(CodeWriter& writer, const sysprop::Property& prop) {
+  writer.Write("enum class %s {\n", GetCppEnumName(prop).c_str());
+  writer.Indent();
+  for (const std::string& name :
+       android::base::Split(prop.enum_values(), "|")) {
+    writer.Write("%s,\n", ToUpper(name).c_str());
+  }
+  writer.Dedent();
+  writer.Write("};\n\n");
+}
+
+bool HasConstantSetter(const sysprop::Property& prop) {
+  if (prop.access() == sysprop::Readonly) return false;
+  switch (prop.type()) {
+    case sysprop::Boolean:
+    case sysprop::Integer:
+    case sysprop::Long:
+    case sysprop::Enum:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Setters taking the value as a template argument, e.g. prop<true>(), so that
+// constants are formatted at compile time. In table-driven mode (non-empty
+// table_key) the value is written through internal::SetRawValue.
+void WriteConstantSetter(CodeWriter& writer, const sysprop::Property& prop,
+                         const std::string& table_key) {
+  std::string prop_id = ApiNameToIdentifier(prop.api_name());
+  std::string value_expr;
+
+  switch (prop.type()) {
+    case sysprop::Boolean:
+      writer.Write("template <bool kValue>\n");
+      value_expr = prop.integer_as_bool() ? "kValue ? \"1\" : \"0\""
+                                          : "kValue ? \"true\" : \"false\"";
+      break;
+    case sysprop::Integer:
+    case sysprop::Long:
+      writer.Write("template <%s kValue>\n",
+                   GetCppScalarTypeName(prop.type()).c_str());
+      value_expr = "::sysprop::IntegerString<kValue>::value.data()";
+      break;
+    case sysprop::Enum:
+      writer.Write("template <%s kValue>\n", GetCppEnumName(prop).c_str());
+      value_expr = "kValues[static_cast<std::size_t>(kValue)]";
+      break;
+    default:
+      __builtin_unreachable();
+  }
+
+  if (prop.deprecated()) writer.Write("[[deprecated]] ");
+  writer.Write("inline bool %s() {\n", prop_id.c_str());
+  writer.Indent();
+  if (prop.type() == sysprop::Enum) {
+    writer.Write("constexpr const char* kValues[] = {");
+    std::vector<std::string> names =
+        android::base::Split(prop.enum_values(), "|");
+    for (std::size_t i = 0; i < names.size(); ++i) {
+      writer.Write("%s\"%s\"", i > 0 ? ", " : "", names[i].c_str());
+    }
+    writer.Write("};\n");
+    writer.Write(
+        "static_assert(static_cast<std::size_t>(kValue) < sizeof(kValues) / "
+        "sizeof(kValues[0]), \"Invalid value for property %s\");\n",
+        prop.prop_name().c_str());
+  }
+  if (!table_key.empty()) {
+    writer.Write("return internal::SetRawValue(%s, %s);\n", table_key.c_str(),
+                 value_expr.c_str());
+  } else {
+    writer.Write("return __system_property_set(\"%s\", %s) == 0;\n",
+                 prop.prop_name().c_str(), value_expr.c_str());
+  }
+  writer.Dedent();
+  writer.Write("}\n");
+}
+
+// FNV-1a of the property name, which table-driven accessors check.
+std::uint32_t GetPropNameHash(const sysprop::Property& prop) {
+  std::uint32_t hash = 2166136261u;
+  for (char c : prop.prop_name()) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+  return hash;
+}
+
+// In table-driven mode, properties are accessed through one generic accessor
+// per type, e.g. GetDouble(key), and enums are passed as their ordinals.
+std::string GetTableAccessorType(const sysprop::Property& prop) {
+  switch (prop.type()) {
+    case sysprop::Enum:
+      return "std::optional<std::int32_t>";
+    case sysprop::EnumList:
+      return "std::vector<std::optional<std::int32_t>>";
+    default:
+      return GetCppPropTypeName(prop);
+  }
+}
+
+// Struct accessors can't be shared, so they are named after the property.
+std::string GetTableAccessorName(const sysprop::Property& prop) {
+  if (prop.type() == sysprop::Struct) {
+    return "Struct_" + ApiNameToIdentifier(prop.api_name());
+  }
+  return sysprop::Type_Name(prop.type());
+}
+
+void WriteTableAccessorDeclarations(CodeWriter& writer,
+                                    const sysprop::Properties& props,
+                                    sysprop::Scope scope) {
+  std::set<sysprop::Type> getters;
+  std::set<sysprop::Type> setters;
+  for (int i = 0; i < props.prop_size(); ++i) {
+    const sysprop::Property& prop = props.prop(i);
+    // Struct accessors are declared along with the struct.
+    if (prop.scope() > scope || prop.type() == sysprop::Struct) continue;
+    getters.insert(prop.type());
+    if (prop.access() != sysprop::Readonly) setters.insert(prop.type());
+  }
+
+  writer.Write("%s", kCppTableKeyComment);
+  writer.Write("namespace internal {\n\n");
+
+  for (int i = 0; i < props.prop_size(); ++i) {
+    const sysprop::Property& prop = props.prop(i);
+    std::string accessor_type = GetTableAccessorType(prop);
+    const std::string& type_name = sysprop::Type_Name(prop.type());
+    if (getters.erase(prop.type()) != 0) {
+      writer.Write("%s Get%s(std::uint64_t key);\n", accessor_type.c_str(),
+                   type_name.c_str());
+    }
+    if (setters.erase(prop.type()) != 0) {
+      writer.Write("bool Set%s(std::uint64_t key, const %s& value);\n",
+                   type_name.c_str(), accessor_type.c_str());
+    }
+  }
+
+  bool has_enum = false;
+  bool has_flags_getter = false;
+  bool has_flags_setter = false;
+  bool has_constant_setter = false;
+  for (int i = 0; i < props.prop_size(); ++i) {
+    const sysprop::Property& prop = props.prop(i);
+    if (prop.scope() > scope) continue;
+    if (HasConstantSetter(prop)) has_constant_setter = true;
+    if (prop.type() == sysprop::Enum || prop.type() == sysprop::EnumList) {
+      has_enum = true;
+    }
+    if (HasEnumFlags(prop)) {
+      has_flags_getter = true;
+      if (prop.access() != sysprop::Readonly) has_flags_setter = true;
+    }
+  }
+  if (has_constant_setter) {
+    writer.Write("bool SetRawValue(std::uint64_t key, const char* value);\n");
+  }
+  if (has_flags_getter) {
+    writer.Write("std::uint64_t GetEnumFlags(std::uint64_t key);\n");
+  }
+  if (has_flags_setter) {
+    writer.Write(
+        "bool SetEnumFlags(std::uint64_t key, std::uint64_t value);\n");
+  }
+  if (has_enum) writer.Write("\n%s", kCppTableEnumConverters);
+
+  writer.Write("\n}  // namespace internal\n\n");
+}
+
+void WriteTableAccessors(CodeWriter& writer, const sysprop::Property& prop,
+                         int index) {
+  std::string key = android::base::StringPrintf(
+      "0x%08x%08xull", GetPropNameHash(prop), index);
+  std::string prop_id = ApiNameToIdentifier(prop.api_name());
+  std::string prop_type = GetCppPropTypeName(prop);
+  std::string type_name = GetTableAccessorName(prop);
+  bool is_enum =
+      prop.type() == sysprop::Enum || prop.type() == sysprop::EnumList;
+
+  if (prop.type() == sysprop::Struct) {
+    writer.Write("namespace internal {\n");
+    writer.Write("%s Get%s(std::uint64_t key);\n", prop_type.c_str(),
+                 type_name.c_str());
+    if (prop.access() != sysprop::Readonly) {
+      writer.Write("bool Set%s(std::uint64_t key, const %s& value);\n",
+                   type_name.c_str(), prop_type.c_str());
+    }
+    writer.Write("}  // namespace internal\n\n");
+  }
+
+  if (prop.deprecated()) writer.Write("[[deprecated]] ");
+  writer.Write("inline %s %s() {\n", prop_type.c_str(), prop_id.c_str());
+  writer.Indent();
+  if (is_enum) {
+    writer.Write("return internal::ToEnum<%s>(internal::Get%s(%s));\n",
+                 GetCppEnumName(prop).c_str(), type_name.c_str(), key.c_str());
+  } else {
+    writer.Write("return internal::Get%s(%s);\n", type_name.c_str(),
+                 key.c_str());
+  }
+  writer.Dedent();
+  writer.Write("}\n");
+
+  if (prop.access() != sysprop::Readonly) {
+    if (prop.deprecated()) writer.Write("[[deprecated]] ");
+    writer.Write("inline bool %s(const %s& value) {\n", prop_id.c_str(),
+                 prop_type.c_str());
+    writer.Indent();
+    writer.Write("return internal::Set%s(%s, %s);\n", type_name.c_str(),
+                 key.c_str(), is_enum ? "internal::FromEnum(value)" : "value");
+    writer.Dedent();
+    writer.Write("}\n");
+  }
+  if (HasConstantSetter(prop)) WriteConstantSetter(writer, prop, key);
+
+  if (!HasEnumFlags(prop)) return;
+
+  std::string flags_type = GetCppEnumFlagsTypeName(prop);
+  if (prop.deprecated()) writer.Write("[[deprecated]] ");
+  writer.Write("inline %s %s_flags() {\n", flags_type.c_str(),
+               prop_id.c_str());
+  writer.Indent();
+  writer.Write("return %s(internal::GetEnumFlags(%s));\n", flags_type.c_str(),
+               key.c_str());
+  writer.Dedent();
+  writer.Write("}\n");
+
+  if (prop.access() != sysprop::Readonly) {
+    if (prop.deprecated()) writer.Write("[[deprecated]] ");
+    writer.Write("inline bool %s_flags(const %s& value) {\n", prop_id.c_str(),
+                 flags_type.c_str());
+    writer.Indent();
+    writer.Write("return internal::SetEnumFlags(%s, value.bits());\n",
+                 key.c_str());
+    writer.Dedent();
+    writer.Write("}\n");
+  }
+}
+
+void WriteChangeHistories(CodeWriter& writer,
+                          const sysprop::Properties& props) {
+  writer.Write("%s", kCppChangeHistory);
+  writer.Write("constexpr const char* kChangeHistoryNames[] = {\n");
+  writer.Indent();
+  for (const sysprop::Property& prop : props.prop()) {
+    writer.Write("\"%s\",\n", prop.prop_name().c_str());
+  }
+  writer.Dedent();
+  writer.Write("};\n\n");
+  writer.Write("ChangeHistory gChangeHistories[%d];\n\n", props.prop_size());
+}
+
+void WriteGetPropChangeStats(CodeWriter& writer,
+                             const sysprop::Properties& props) {
+  writer.Write(
+      "std::vector<PropChangeStats> GetPropChangeStats(std::uint64_t "
+      "window_ns) {\n");
+  writer.Indent();
+  writer.Write("std::uint64_t now = NowNs();\n");
+  writer.Write("std::vector<PropChangeStats> ret;\n");
+  writer.Write("ret.reserve(%d);\n", props.prop_size());
+  writer.Write("for (std::size_t i = 0; i < %d; ++i) {\n", props.prop_size());
+  writer.Indent();
+  writer.Write(
+      "ret.push_back(CollectChangeStats(kChangeHistoryNames[i], "
+      "gChangeHistories[i], now, window_ns));\n");
+  writer.Dedent();
+  writer.Write("}\n");
+  writer.Write("return ret;\n");
+  writer.Dedent();
+  writer.Write("}\n");
+}
+
+void WriteModuleRegistration(CodeWriter& writer,
+                             const sysprop::Properties& props,
+                             const CppGenOptions& options) {
+  writer.Write("constexpr const char* kRegisteredPropNames[] = {\n");
+  writer.Indent();
+  for (const sysprop::Property& prop : props.prop()) {
+    writer.Write("\"%s\",\n", prop.prop_name().c_str());
+  }
+  writer.Dedent();
+  writer.Write("};\n\n");
+  writer.Write("std::atomic<const prop_info*> gPropHandles[%d];\n",
+               props.prop_size());
+  if (options.instrumented) {
+    writer.Write("std::atomic<std::uint64_t> gSavedLookups;\n\n");
+    writer.Write("%s", kCppFindPropCounted);
+  } else {
+    writer.Write("\n%s", kCppFindProp);
+  }
+
+  writer.Write("const ::sysprop::ModuleDescriptor kModuleDescriptor = {\n");
+  writer.Indent();
+  writer.Write(
+      "\"%s\", %d, kRegisteredPropNames, gPropHandles, %s,\n",
+      props.module().c_str(), props.prop_size(),
+      options.instrumented ? "&gSavedLookups" : "nullptr");
+  writer.Dedent();
+  writer.Write("};\n\n");
+
+  writer.Write(
+      "const ::sysprop::ModuleRegistration kModuleRegistration("
+      "&kModuleDescriptor);\n\n");
+}
+
+// FNV-1a over everything which decides the snapshot layout.
+std::uint64_t GetSnapshotSchemaHash(const sysprop::Properties& props) {
+  std::string schema = props.module();
+  for (const sysprop::Property& prop : props.prop()) {
+    schema += "|" + prop.api_name() + ":" + sysprop::Type_Name(prop.type()) +
+              ":" + prop.enum_values();
+    for (const sysprop::StructField& field : prop.struct_fields()) {
+      schema += "," + field.name() + ":" + sysprop::Type_Name(field.type()) +
+                ":" + field.enum_values();
+    }
+  }
+
+  std::uint64_t hash = 14695981039346656037ull;
+  for (char c : schema) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+// Snapshots include every property, so they are only declared in the
+// internal header.
+void WriteSnapshotDeclaration(CodeWriter& writer,
+                              const sysprop::Properties& props) {
+  writer.Write("struct Snapshot {\n");
+  writer.Indent();
+  for (const sysprop::Property& prop : props.prop()) {
+    writer.Write("%s %s;\n", GetCppPropTypeName(prop).c_str(),
+                 ApiNameToIdentifier(prop.api_name()).c_str());
+  }
+  writer.Dedent();
+  writer.Write("};\n\n");
+  writer.Write("Snapshot ReadSnapshot();\n");
+  writer.Write("std::string SerializeSnapshot(const Snapshot& snapshot);\n");
+  writer.Write(
+      "std::optional<Snapshot> DeserializeSnapshot(std::string_view data);\n");
+}
+
+void WriteSnapshotHelpers(CodeWriter& writer,
+                          const sysprop::Properties& props) {
+  std::set<sysprop::Type> scalars;
+  std::vector<std::pair<std::string, int>> enums;
+  std::vector<const sysprop::Property*> structs;
+  std::vector<std::string> lists;
+  std::vector<std::string> maps;
+  std::set<std::string> seen;
+
+  for (const sysprop::Property& prop : props.prop()) {
+    sysprop::Type element_type = GetElementType(prop);
+    if (element_type == sysprop::Enum) {
+      enums.emplace_back(GetCppEnumName(prop),
+                         android::base::Split(prop.enum_values(), "|").size());
+    } else if (element_type == sysprop::Struct) {
+      structs.push_back(&prop);
+      for (const sysprop::StructField& field : prop.struct_fields()) {
+        if (field.type() == sysprop::Enum) {
+          enums.emplace_back(
+              GetCppStructName(prop) + "::" + GetCppStructFieldEnumName(field),
+              android::base::Split(field.enum_values(), "|").size());
+        } else {
+          scalars.insert(field.type());
+        }
+      }
+    } else {
+      scalars.insert(element_type);
+    }
+
+    if (!IsListProp(prop) && !IsMapProp(prop)) continue;
+    std::string element_name = element_type == sysprop::Enum
+                                   ? GetCppEnumName(prop)
+                                   : GetCppScalarTypeName(element_type);
+    std::string kind = IsListProp(prop) ? "list " : "map ";
+    if (seen.insert(kind + element_name).second) {
+      (IsListProp(prop) ? lists : maps).push_back(element_name);
+    }
+  }
+  // Map keys are written as strings.
+  if (!maps.empty()) scalars.insert(sysprop::String);
+
+  writer.Write("%s", kCppSnapshotBase);
+
+  std::vector<std::string> optionals;
+  for (const SnapshotHelpers& helpers : kCppSnapshotPayloads) {
+    if (scalars.count(helpers.type) == 0) continue;
+    writer.Write("%s", helpers.payload);
+    optionals.push_back(GetCppScalarTypeName(helpers.type));
+  }
+
+  for (auto [enum_name, count] : enums) {
+    writer.Write("void PutPayload(std::string* out, %s value) {\n",
+                 enum_name.c_str());
+    writer.Indent();
+    writer.Write("PutVarint(out, static_cast<std::uint64_t>(value));\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+    writer.Write("bool GetPayload(std::string_view* in, %s* value) {\n",
+                 enum_name.c_str());
+    writer.Indent();
+    writer.Write("std::uint64_t raw;\n");
+    writer.Write("if (!GetVarint(in, &raw) || raw >= %d) return false;\n",
+                 count);
+    writer.Write("*value = static_cast<%s>(raw);\n", enum_name.c_str());
+    writer.Write("return true;\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+    optionals.push_back(enum_name);
+  }
+
+  auto write_optional = [&](const std::string& type_name) {
+    writer.Write(
+        "void PutValue(std::string* out, const std::optional<%s>& value) {\n",
+        type_name.c_str());
+    writer.Indent();
+    writer.Write("*out += static_cast<char>(value.has_value());\n");
+    writer.Write("if (value) PutPayload(out, *value);\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+    writer.Write(
+        "bool GetValue(std::string_view* in, std::optional<%s>* value) {\n",
+        type_name.c_str());
+    writer.Indent();
+    writer.Write("bool present;\n");
+    writer.Write("if (!GetPresence(in, &present)) return false;\n");
+    writer.Write("if (!present) {\n");
+    writer.Indent();
+    writer.Write("*value = std::nullopt;\n");
+    writer.Write("return true;\n");
+    writer.Dedent();
+    writer.Write("}\n");
+    writer.Write("return GetPayload(in, &value->emplace());\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+  };
+
+  for (const std::string& type_name : optionals) write_optional(type_name);
+
+  for (const sysprop::Property* prop : structs) {
+    std::string struct_name = GetCppStructName(*prop);
+    writer.Write("void PutPayload(std::string* out, const %s& value) {\n",
+                 struct_name.c_str());
+    writer.Indent();
+    for (const sysprop::StructField& field : prop->struct_fields()) {
+      writer.Write("PutValue(out, value.%s);\n", field.name().c_str());
+    }
+    writer.Dedent();
+    writer.Write("}\n\n");
+    writer.Write("bool GetPayload(std::string_view* in, %s* value) {\n",
+                 struct_name.c_str());
+    writer.Indent();
+    writer.Write("return ");
+    for (int i = 0; i < prop->struct_fields_size(); ++i) {
+      writer.Write("%sGetValue(in, &value->%s)", i > 0 ? " && " : "",
+                   prop->struct_fields(i).name().c_str());
+    }
+    writer.Write(";\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+    write_optional(struct_name);
+  }
+
+  // Every element takes at least one byte, which bounds the sizes.
+  for (const std::string& element_name : lists) {
+    std::string list_type = "std::vector<std::optional<" + element_name + ">>";
+    writer.Write("void PutValue(std::string* out, const %s& value) {\n",
+                 list_type.c_str());
+    writer.Indent();
+    writer.Write("PutVarint(out, value.size());\n");
+    writer.Write("for (auto&& element : value) PutValue(out, element);\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+    writer.Write("bool GetValue(std::string_view* in, %s* value) {\n",
+                 list_type.c_str());
+    writer.Indent();
+    writer.Write("std::uint64_t size;\n");
+    writer.Write(
+        "if (!GetVarint(in, &size) || size > in->size()) return false;\n");
+    writer.Write("value->resize(size);\n");
+    writer.Write("for (auto& element : *value) {\n");
+    writer.Indent();
+    writer.Write("if (!GetValue(in, &element)) return false;\n");
+    writer.Dedent();
+    writer.Write("}\n");
+    writer.Write("return true;\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+  }
+
+  for (const std::string& value_name : maps) {
+    std::string map_type = "::sysprop::FlatMap<" + value_name + ">";
+    writer.Write("void PutValue(std::string* out, const %s& value) {\n",
+                 map_type.c_str());
+    writer.Indent();
+    writer.Write("PutVarint(out, value.size());\n");
+    writer.Write("for (std::size_t i = 0; i < value.size(); ++i) {\n");
+    writer.Indent();
+    writer.Write("PutPayload(out, std::string(value.key(i)));\n");
+    writer.Write("PutValue(out, value.value(i));\n");
+    writer.Dedent();
+    writer.Write("}\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+    writer.Write("bool GetValue(std::string_view* in, %s* value) {\n",
+                 map_type.c_str());
+    writer.Indent();
+    writer.Write("std::uint64_t size;\n");
+    writer.Write(
+        "if (!GetVarint(in, &size) || size > in->size()) return false;\n");
+    writer.Write("std::string key;\n");
+    writer.Write("for (std::uint64_t i = 0; i < size; ++i) {\n");
+    writer.Indent();
+    writer.Write("std::optional<%s> element;\n", value_name.c_str());
+    writer.Write(
+        "if (!GetPayload(in, &key) || !GetValue(in, &element)) return "
+        "false;\n");
+    writer.Write("value->insert(key, std::move(element));\n");
+    writer.Dedent();
+    writer.Write("}\n");
+    writer.Write("return true;\n");
+    writer.Dedent();
+    writer.Write("}\n\n");
+  }
+}
+
+void WriteSnapshotFunctions(CodeWriter& writer,
+                            const sysprop::Properties& props) {
+  bool has_deprecated = false;
+  for (const sysprop::Property& prop : props.prop()) {
+    if (prop.deprecated()) has_deprecated = true;
+  }
+
+  if (has_deprecated) {
+    writer.Write("#pragma GCC diagnostic push\n");
+    writer.Write(
+        "#pragma GCC diagnostic ignored \"-Wdeprecated-declarations\"\n");
+  }
+  writer.Write("Snapshot ReadSnapshot() {\n");
+  writer.Indent();
+  writer.Write("Snapshot ret;\n");
+  for (const sysprop::Property& prop : props.prop()) {
+    std::string prop_id = ApiNameToIdentifier(prop.api_name());
+    writer.Write("ret.%s = %s();\n", prop_id.c_str(), prop_id.c_str());
+  }
+  writer.Write("return ret;\n");
+  writer.Dedent();
+  writer.Write("}\n");
+  if (has_deprecated) writer.Write("#pragma GCC diagnostic pop\n");
+
+  writer.Write("\nstd::string SerializeSnapshot(const Snapshot& snapshot) {\n");
+  writer.Indent();
+  writer.Write("std::string ret = \"SYSP\";\n");
+  writer.Write("PutVarint(&ret, kSnapshotVersion);\n");
+  writer.Write("PutFixed64(&ret, 0x%016" PRIx64 "ull);\n",
+               GetSnapshotSchemaHash(props));
+  for (const sysprop::Property& prop : props.prop()) {
+    writer.Write("PutValue(&ret, snapshot.%s);\n",
+                 ApiNameToIdentifier(prop.api_name()).c_str());
+  }
+  writer.Write("return ret;\n");
+  writer.Dedent();
+  writer.Write("}\n");
+
+  writer.Write(
+      "\nstd::optional<Snapshot> DeserializeSnapshot(std::string_view data) "
+      "{\n");
+  writer.Indent();
+  writer.Write("std::uint64_t version;\n");
+  writer.Write("std::uint64_t schema_hash;\n");
+  writer.Write("if (data.substr(0, 4) != \"SYSP\") return std::nullopt;\n");
+  writer.Write("data.remove_prefix(4);\n");
+  writer.Write(
+      "if (!GetVarint(&data, &version) || version != kSnapshotVersion) "
+      "return std::nullopt;\n");
+  writer.Write(
+      "if (!GetFixed64(&data, &schema_hash) || schema_hash != "
+      "0x%016" PRIx64 "ull) return std::nullopt;\n",
+      GetSnapshotSchemaHash(props));
+  writer.Write("Snapshot ret;\n");
+  for (const sysprop::Property& prop : props.prop()) {
+    writer.Write("if (!GetValue(&data, &ret.%s)) return std::nullopt;\n",
+                 ApiNameToIdentifier(prop.api_name()).c_str());
+  }
+  writer.Write("if (!data.empty()) return std::nullopt;\n");
+  writer.Write("return ret;\n");
+  writer.Dedent();
+  writer.Write("}\n");
+}
+
+std::string GenerateHeader(const sysprop::Properties& props,
+                           sysprop::Scope scope,
+                           const CppGenOptions& options) {
+  CodeWriter writer(kIndent);
+
+  writer.Write("%s", kGeneratedFileFooterComments);
+
+  writer.Write("#pragma once\n\n");
+
+  // Helpers shared by generated headers are emitted only if they are used.
+  std::set<std::string> includes(std::begin(kCppHeaderIncludes),
+                                 std::end(kCppHeaderIncludes));
+  bool has_map = false;
+  bool has_flags = false;
+  bool has_integer_constant = false;
+  bool has_constant_setter = false;
+  for (int i = 0; i < props.prop_size(); ++i) {
+    const sysprop::Property& prop = props.prop(i);
+    if (prop.scope() > scope) continue;
+    if (IsMapProp(prop)) {
+      has_map = true;
+      includes.insert({"cstddef", "string_view", "utility"});
+    }
+    if (HasEnumFlags(prop)) {
+      has_flags = true;
+      includes.insert("initializer_list");
+    }
+    if (HasConstantSetter(prop)) {
+      has_constant_setter = true;
+      includes.insert("cstddef");
+      if (prop.type() == sysprop::Integer || prop.type() == sysprop::Long) {
+        has_integer_constant = true;
+        includes.insert("array");
+      }
+    }
+  }
+
+  bool has_snapshot = options.snapshot && scope == sysprop::Internal;
+  if (has_snapshot) includes.insert("string_view");
+
+  for (const std::string& include : includes) {
+    writer.Write("#include <%s>\n", include.c_str());
+  }
+  writer.Write("\n");
+  if (has_constant_setter && !options.table_driven) {
+    writer.Write("#include <sys/system_properties.h>\n\n");
+  }
+  if (options.module_registry) {
+    writer.Write("#include <sysprop/ModuleRegistry.h>\n\n");
+  }
+
+  if (has_map) writer.Write("%s", kCppFlatMap);
+  if (has_flags) writer.Write("%s", kCppEnumFlags);
+  if (has_integer_constant) writer.Write("%s", kCppIntegerString);
+
+  std::string cpp_namespace = GetCppNamespace(props);
+  writer.Write("namespace %s {\n\n", cpp_namespace.c_str());
+
+  if (options.table_driven) {
+    WriteTableAccessorDeclarations(writer, props, scope);
+  }
+
+  bool first = true;
+
+  for (int i = 0; i < props.prop_size(); ++i) {
+    const sysprop::Property& prop = props.prop(i);
+
+    // Scope: Internal > Public
+    if (prop.scope() > scope) continue;
+
+    if (!first) {
+      writer.Write("\n");
+    } else {
+      first = false;
+    }
 
     std::string prop_id = ApiNameToIdentifier(prop.api_name());
     std::string prop_type = GetCppPropTypeName(prop);
 
     if (prop.type() == sysprop::Enum || prop.type() == sysprop::EnumList) {
-      writer.Write("enum class %s {\n", GetCppEnumName(prop).c_str());
-      writer.Indent();
-      for (const std::string& name :
-           android::base::Split(prop.enum_values(), "|")) {
-        writer.Write("%s,\n", ToUpper(name).c_str());
-      }
-      writer.Dedent();
-      writer.Write("};\n\n");
+      WriteEnumDeclaration(writer, prop);
+    } else if (prop.type() == sysprop::Struct) {
+      WriteStructDeclaration(writer, prop);
+    }
+
+    if (options.table_driven) {
+      WriteTableAccessors(writer, prop, i);
+      continue;
     }
 
     if (prop.deprecated()) writer.Write("[[deprecated]] ");
@@ -294,6 +2142,25 @@ std::string GenerateHeader(const sysprop::Properties& props,
       writer.Write("bool %s(const %s& value);\n", prop_id.c_str(),
                    prop_type.c_str());
     }
+    if (HasConstantSetter(prop)) WriteConstantSetter(writer, prop, "");
+
+    if (HasEnumFlags(prop)) {
+      std::string flags_type = GetCppEnumFlagsTypeName(prop);
+      if (prop.deprecated()) writer.Write("[[deprecated]] ");
+      writer.Write("%s %s_flags();\n", flags_type.c_str(), prop_id.c_str());
+      if (prop.access() != sysprop::Readonly) {
+        if (prop.deprecated()) writer.Write("[[deprecated]] ");
+        writer.Write("bool %s_flags(const %s& value);\n", prop_id.c_str(),
+                     flags_type.c_str());
+      }
+    }
+  }
+
+  if (options.instrumented) writer.Write("\n%s", kCppChangeStatsDeclaration);
+
+  if (has_snapshot) {
+    writer.Write("\n");
+    WriteSnapshotDeclaration(writer, props);
   }
 
   writer.Write("\n}  // namespace %s\n", cpp_namespace.c_str());
@@ -301,130 +2168,495 @@ std::string GenerateHeader(const sysprop::Properties& props,
   return writer.Code();
 }
 
+void WriteSourceExtraIncludes(CodeWriter& writer, const CppGenOptions& options,
+                              const std::vector<PropAccess>& accesses) {
+  std::set<std::string> includes;
+  if (options.instrumented) includes.insert({"algorithm", "atomic", "chrono"});
+  for (const PropAccess& access : accesses) {
+    if (access.strategy == AccessStrategy::kPlain) continue;
+    if (!options.module_registry) includes.insert("atomic");
+    if (access.strategy == AccessStrategy::kSerialCache) {
+      includes.insert({"atomic", "mutex", "type_traits"});
+    }
+  }
+
+  for (const std::string& include : includes) {
+    writer.Write("#include <%s>\n", include.c_str());
+  }
+  if (!includes.empty()) writer.Write("\n");
+}
+
+// Getters of a property and of its flags are written alike, with prop_type
+// being the type they return.
+void WriteGetterBody(CodeWriter& writer, const sysprop::Property& prop,
+                     int index, AccessStrategy strategy,
+                     const std::string& prop_type,
+                     const CppGenOptions& options, bool by_handle) {
+  std::string history_arg =
+      options.instrumented
+          ? ", &gChangeHistories[" + std::to_string(index) + "]"
+          : "";
+  std::string key = "\"" + prop.prop_name() + "\"";
+  if (options.module_registry) {
+    key = "FindProp(" + std::to_string(index) + ", " + key + ")";
+  } else if (strategy != AccessStrategy::kPlain) {
+    writer.Write("static std::atomic<const prop_info*> handle;\n");
+    key = "FindCachedProp(&handle, " + key + ")";
+  } else if (by_handle) {
+    key = "__system_property_find(" + key + ")";
+  }
+
+  switch (strategy) {
+    case AccessStrategy::kPlain:
+    case AccessStrategy::kCachedHandle:
+      writer.Write("%s ret;\n", prop_type.c_str());
+      writer.Write("GetProp(%s, &ret%s);\n", key.c_str(), history_arg.c_str());
+      writer.Write("return ret;\n");
+      break;
+    case AccessStrategy::kSerialCache:
+      writer.Write(
+          "static_assert(std::is_trivially_copyable_v<%s> && sizeof(%s) <= "
+          "sizeof(SerialCache::words));\n",
+          prop_type.c_str(), prop_type.c_str());
+      writer.Write("static SerialCache cache;\n");
+      writer.Write("const prop_info* pi = %s;\n", key.c_str());
+      writer.Write("if (pi == nullptr) return {};\n\n");
+      writer.Write("std::uint32_t serial = __system_property_serial(pi);\n");
+      writer.Write("%s ret;\n", prop_type.c_str());
+      writer.Write(
+          "if (LoadCached(&cache, serial, &ret, sizeof(ret))) return ret;\n");
+      writer.Write("GetProp(pi, &ret%s);\n", history_arg.c_str());
+      writer.Write("StoreCached(&cache, serial, &ret, sizeof(ret));\n");
+      writer.Write("return ret;\n");
+      break;
+    case AccessStrategy::kMemoize:
+      writer.Write("const prop_info* pi = %s;\n", key.c_str());
+      writer.Write("if (pi == nullptr) return {};\n\n");
+      writer.Write("// ro. properties never change once they are set.\n");
+      writer.Write("static const %s memo = [pi] {\n", prop_type.c_str());
+      writer.Indent();
+      writer.Write("%s ret;\n", prop_type.c_str());
+      writer.Write("GetProp(pi, &ret%s);\n", history_arg.c_str());
+      writer.Write("return ret;\n");
+      writer.Dedent();
+      writer.Write("}();\n");
+      writer.Write("return memo;\n");
+      break;
+  }
+}
+
 std::string GenerateSource(const sysprop::Properties& props,
-                           const std::string& include_name) {
+                           const std::string& include_name,
+                           const CppGenOptions& options,
+                           const std::vector<PropAccess>& accesses) {
+  bool by_handle = options.module_registry;
+  for (const PropAccess& access : accesses) {
+    if (access.strategy != AccessStrategy::kPlain) by_handle = true;
+  }
+
   CodeWriter writer(kIndent);
   writer.Write("%s", kGeneratedFileFooterComments);
   writer.Write("#include <%s>\n\n", include_name.c_str());
   writer.Write("%s", kCppSourceIncludes);
+  WriteSourceExtraIncludes(writer, options, accesses);
 
   std::string cpp_namespace = GetCppNamespace(props);
 
   writer.Write("namespace {\n\n");
   writer.Write("using namespace %s;\n\n", cpp_namespace.c_str());
-  writer.Write("template <typename T> T DoParse(const char* str);\n\n");
 
+  UsedTypes used;
   for (int i = 0; i < props.prop_size(); ++i) {
-    const sysprop::Property& prop = props.prop(i);
-    if (prop.type() != sysprop::Enum && prop.type() != sysprop::EnumList) {
-      continue;
+    CollectUsedTypes(props.prop(i), &used);
+  }
+
+  for (int i = 0; i < props.prop_size(); ++i) {
+    WritePropEnumHelpers(writer, props.prop(i));
+  }
+
+  if (options.instrumented) WriteChangeHistories(writer, props);
+  if (options.module_registry) WriteModuleRegistration(writer, props, options);
+  if (by_handle && !options.module_registry) {
+    writer.Write("%s", kCppFindCachedProp);
+  }
+  for (const PropAccess& access : accesses) {
+    if (access.strategy == AccessStrategy::kSerialCache) {
+      writer.Write("%s", kCppSerialCache);
+      break;
     }
+  }
+  WriteHelpers(writer, used, options, by_handle);
+  if (options.snapshot) WriteSnapshotHelpers(writer, props);
+
+  writer.Write("}  // namespace\n\n");
+
+  writer.Write("namespace %s {\n\n", cpp_namespace.c_str());
 
+  for (int i = 0; i < props.prop_size(); ++i) {
+    if (i > 0) writer.Write("\n");
+
+    const sysprop::Property& prop = props.prop(i);
     std::string prop_id = ApiNameToIdentifier(prop.api_name());
-    std::string enum_name = GetCppEnumName(prop);
+    std::string prop_type = GetCppPropTypeName(prop);
+    AccessStrategy strategy =
+        accesses.empty() ? AccessStrategy::kPlain : accesses[i].strategy;
 
-    writer.Write("constexpr const std::pair<const char*, %s> %s_list[] = {\n",
-                 enum_name.c_str(), prop_id.c_str());
+    writer.Write("%s %s() {\n", prop_type.c_str(), prop_id.c_str());
     writer.Indent();
-    for (const std::string& name :
-         android::base::Split(prop.enum_values(), "|")) {
-      writer.Write("{\"%s\", %s::%s},\n", name.c_str(), enum_name.c_str(),
-                   ToUpper(name).c_str());
-    }
+    WriteGetterBody(writer, prop, i, strategy, prop_type, options, by_handle);
     writer.Dedent();
-    writer.Write("};\n\n");
+    writer.Write("}\n");
 
-    writer.Write("template <>\n");
-    writer.Write("std::optional<%s> DoParse(const char* str) {\n",
-                 enum_name.c_str());
-    writer.Indent();
-    writer.Write("for (auto [name, val] : %s_list) {\n", prop_id.c_str());
-    writer.Indent();
-    writer.Write("if (strcmp(str, name) == 0) {\n");
+    if (prop.access() != sysprop::Readonly) {
+      writer.Write("\nbool %s(const %s& value) {\n", prop_id.c_str(),
+                   prop_type.c_str());
+      writer.Indent();
+      writer.Write("return __system_property_set(\"%s\", %s) == 0;\n",
+                   prop.prop_name().c_str(),
+                   GetFormattingExpression(prop).c_str());
+      writer.Dedent();
+      writer.Write("}\n");
+    }
+
+    if (!HasEnumFlags(prop)) continue;
+
+    std::string flags_type = GetCppEnumFlagsTypeName(prop);
+    writer.Write("\n%s %s_flags() {\n", flags_type.c_str(), prop_id.c_str());
     writer.Indent();
-    writer.Write("return val;\n");
-    writer.Dedent();
-    writer.Write("}\n");
+    WriteGetterBody(writer, prop, i, strategy, flags_type, options, by_handle);
     writer.Dedent();
     writer.Write("}\n");
-    writer.Write("return std::nullopt;\n");
-    writer.Dedent();
-    writer.Write("}\n\n");
 
     if (prop.access() != sysprop::Readonly) {
-      writer.Write("std::string FormatValue(std::optional<%s> value) {\n",
-                   enum_name.c_str());
-      writer.Indent();
-      writer.Write("if (!value) return \"\";\n");
-      writer.Write("for (auto [name, val] : %s_list) {\n", prop_id.c_str());
+      writer.Write("\nbool %s_flags(const %s& value) {\n", prop_id.c_str(),
+                   flags_type.c_str());
       writer.Indent();
-      writer.Write("if (val == *value) {\n");
-      writer.Indent();
-      writer.Write("return name;\n");
-      writer.Dedent();
-      writer.Write("}\n");
+      writer.Write(
+          "return __system_property_set(\"%s\", FormatValue(value).c_str()) == "
+          "0;\n",
+          prop.prop_name().c_str());
       writer.Dedent();
       writer.Write("}\n");
+    }
+  }
 
-      writer.Write(
-          "LOG_ALWAYS_FATAL(\"Invalid value %%d for property %s\", "
-          "static_cast<std::int32_t>(*value));\n",
-          prop.prop_name().c_str());
+  if (options.instrumented) {
+    writer.Write("\n");
+    WriteGetPropChangeStats(writer, props);
+  }
 
-      writer.Write("__builtin_unreachable();\n");
-      writer.Dedent();
-      writer.Write("}\n\n");
+  if (options.snapshot) {
+    writer.Write("\n");
+    WriteSnapshotFunctions(writer, props);
+  }
+
+  writer.Write("\n}  // namespace %s\n", cpp_namespace.c_str());
+
+  return writer.Code();
+}
+
+std::string GenerateTableDrivenSource(const sysprop::Properties& props,
+                                      const std::string& include_name,
+                                      const CppGenOptions& options) {
+  CodeWriter writer(kIndent);
+  writer.Write("%s", kGeneratedFileFooterComments);
+  writer.Write("#include <%s>\n\n", include_name.c_str());
+  writer.Write("%s", kCppSourceIncludes);
+  WriteSourceExtraIncludes(writer, options, {});
+
+  std::string cpp_namespace = GetCppNamespace(props);
+
+  writer.Write("namespace {\n\n");
+  writer.Write("using namespace %s;\n\n", cpp_namespace.c_str());
+
+  // Enum values are read and written as strings, and then mapped through the
+  // enum tables below.
+  UsedTypes used;
+  std::vector<sysprop::Type> prop_types;
+  std::vector<const sysprop::Property*> accessors;
+  std::set<std::string> seen_accessors;
+  std::set<std::string> setters;
+  std::set<std::string> integer_as_bool_setters;
+  std::set<std::string> plain_setters;
+  bool has_enum = false;
+  bool has_flags_getter = false;
+  bool has_flags_setter = false;
+
+  for (int i = 0; i < props.prop_size(); ++i) {
+    const sysprop::Property& prop = props.prop(i);
+    if (HasEnumFlags(prop)) {
+      // Flag sets are parsed from the raw string value.
+      sysprop::Property raw_prop;
+      raw_prop.set_type(sysprop::String);
+      CollectUsedTypes(raw_prop, &used);
+      has_flags_getter = true;
+      if (prop.access() != sysprop::Readonly) has_flags_setter = true;
+    }
+    if (prop.type() == sysprop::Enum || prop.type() == sysprop::EnumList) {
+      sysprop::Property raw_prop;
+      raw_prop.set_type(IsListProp(prop) ? sysprop::StringList
+                                         : sysprop::String);
+      CollectUsedTypes(raw_prop, &used);
+      has_enum = true;
+    } else {
+      CollectUsedTypes(prop, &used);
+    }
+
+    std::string accessor_name = GetTableAccessorName(prop);
+    if (std::find(prop_types.begin(), prop_types.end(), prop.type()) ==
+        prop_types.end()) {
+      prop_types.push_back(prop.type());
+    }
+    if (seen_accessors.insert(accessor_name).second) {
+      accessors.push_back(&prop);
+    }
+    if (prop.access() != sysprop::Readonly) {
+      setters.insert(accessor_name);
+      if (prop.integer_as_bool()) {
+        integer_as_bool_setters.insert(accessor_name);
+      } else {
+        plain_setters.insert(accessor_name);
+      }
     }
   }
-  writer.Write("%s", kCppParsersAndFormatters);
-  writer.Write("}  // namespace\n\n");
 
-  writer.Write("namespace %s {\n\n", cpp_namespace.c_str());
+  writer.Write("enum PropType : std::uint8_t {\n");
+  writer.Indent();
+  for (sysprop::Type type : prop_types) {
+    writer.Write("k%s,\n", sysprop::Type_Name(type).c_str());
+  }
+  writer.Dedent();
+  writer.Write("};\n\n");
+
+  writer.Write("%s", kCppTablePropDescriptor);
 
+  writer.Write("constexpr const char kPropNames[] =\n");
+  writer.Indent();
   for (int i = 0; i < props.prop_size(); ++i) {
-    if (i > 0) writer.Write("\n");
+    writer.Write("\"%s\\0\"%s\n", props.prop(i).prop_name().c_str(),
+                 i + 1 < props.prop_size() ? "" : ";");
+  }
+  writer.Dedent();
+  writer.Write("\n");
 
+  std::vector<std::string> enum_values;
+  std::vector<std::pair<std::size_t, std::size_t>> enum_tables;
+
+  writer.Write("constexpr const PropDescriptor kProps[] = {\n");
+  writer.Indent();
+  std::size_t name_offset = 0;
+  for (int i = 0; i < props.prop_size(); ++i) {
     const sysprop::Property& prop = props.prop(i);
-    std::string prop_id = ApiNameToIdentifier(prop.api_name());
-    std::string prop_type = GetCppPropTypeName(prop);
+    std::size_t enum_table = 0;
+    if (prop.type() == sysprop::Enum || prop.type() == sysprop::EnumList) {
+      std::vector<std::string> names =
+          android::base::Split(prop.enum_values(), "|");
+      enum_table = enum_tables.size();
+      enum_tables.emplace_back(enum_values.size(), names.size());
+      enum_values.insert(enum_values.end(), names.begin(), names.end());
+    }
+    writer.Write("{%zu, 0x%08x, %zu, k%s, %s},\n", name_offset,
+                 GetPropNameHash(prop), enum_table,
+                 sysprop::Type_Name(prop.type()).c_str(),
+                 prop.integer_as_bool() ? "kIntegerAsBool" : "0");
+    name_offset += prop.prop_name().size() + 1;
+  }
+  writer.Dedent();
+  writer.Write("};\n\n");
 
-    writer.Write("%s %s() {\n", prop_type.c_str(), prop_id.c_str());
+  if (has_enum) {
+    writer.Write("constexpr const char kEnumValueNames[] =\n");
     writer.Indent();
-    writer.Write("return GetProp<%s>(\"%s\");\n", prop_type.c_str(),
-                 prop.prop_name().c_str());
+    for (std::size_t i = 0; i < enum_values.size(); ++i) {
+      writer.Write("\"%s\\0\"%s\n", enum_values[i].c_str(),
+                   i + 1 < enum_values.size() ? "" : ";");
+    }
     writer.Dedent();
-    writer.Write("}\n");
+    writer.Write("\n");
 
-    if (prop.access() != sysprop::Readonly) {
-      writer.Write("\nbool %s(const %s& value) {\n", prop_id.c_str(),
-                   prop_type.c_str());
-      writer.Indent();
+    writer.Write("constexpr const std::uint32_t kEnumValueOffsets[] = {\n");
+    writer.Indent();
+    std::size_t value_offset = 0;
+    for (const std::string& value : enum_values) {
+      writer.Write("%zu,\n", value_offset);
+      value_offset += value.size() + 1;
+    }
+    writer.Dedent();
+    writer.Write("};\n\n");
 
-      const char* format_expr = "FormatValue(value).c_str()";
-
-      // Specialized formatters here
-      if (prop.type() == sysprop::String) {
-        format_expr = "value ? value->c_str() : \"\"";
-      } else if (prop.integer_as_bool()) {
-        if (prop.type() == sysprop::Boolean) {
-          // optional<bool> -> optional<int>
-          format_expr = "FormatValue(std::optional<int>(value)).c_str()";
-        } else if (prop.type() == sysprop::BooleanList) {
-          // vector<optional<bool>> -> vector<optional<int>>
-          format_expr =
-              "FormatValue(std::vector<std::optional<int>>("
-              "value.begin(), value.end())).c_str()";
-        }
-      }
+    writer.Write("constexpr const EnumTable kEnumTables[] = {\n");
+    writer.Indent();
+    for (auto [first, count] : enum_tables) {
+      writer.Write("{%zu, %zu},\n", first, count);
+    }
+    writer.Dedent();
+    writer.Write("};\n\n");
+  }
 
-      writer.Write("return __system_property_set(\"%s\", %s) == 0;\n",
-                   prop.prop_name().c_str(), format_expr);
+  writer.Write("%s", kCppTableGetPropName);
+  for (int i = 0; i < props.prop_size(); ++i) {
+    if (props.prop(i).type() == sysprop::Struct) {
+      WritePropEnumHelpers(writer, props.prop(i));
+    }
+  }
+  if (options.instrumented) WriteChangeHistories(writer, props);
+  if (options.module_registry) WriteModuleRegistration(writer, props, options);
+  WriteHelpers(writer, used, options, options.module_registry);
+  if (has_enum) writer.Write("%s", kCppTableEnumHelpers);
+  if (setters.count("Enum") != 0 || setters.count("EnumList") != 0) {
+    writer.Write("%s", kCppTableEnumFormatter);
+  }
+  if (setters.count("EnumList") != 0) {
+    writer.Write("%s", kCppTableEnumListFormatter);
+  }
+  if (options.snapshot) WriteSnapshotHelpers(writer, props);
+  if (has_flags_getter) writer.Write("%s", kCppTableEnumFlagsHelpers);
+  if (has_flags_setter) writer.Write("%s", kCppTableEnumFlagsFormatter);
+
+  writer.Write("}  // namespace\n\n");
+
+  writer.Write("namespace %s::internal {\n\n", cpp_namespace.c_str());
+
+  for (std::size_t i = 0; i < accessors.size(); ++i) {
+    if (i > 0) writer.Write("\n");
+
+    const sysprop::Property& prop = *accessors[i];
+    std::string accessor_type = GetTableAccessorType(prop);
+    std::string accessor_name = GetTableAccessorName(prop);
+    const char* type_name = sysprop::Type_Name(prop.type()).c_str();
+    const char* history_arg =
+        options.instrumented ? ", &gChangeHistories[index]" : "";
+    std::string key =
+        "GetPropName(index, k" + sysprop::Type_Name(prop.type()) + ")";
+    if (options.module_registry) key = "FindProp(index, " + key + ")";
+
+    writer.Write("%s Get%s(std::uint64_t key) {\n", accessor_type.c_str(),
+                 accessor_name.c_str());
+    writer.Indent();
+    writer.Write("std::uint32_t index = GetPropIndex(key);\n");
+    if (prop.type() == sysprop::Enum) {
+      writer.Write("std::optional<std::string> value;\n");
+      writer.Write("GetProp(%s, &value%s);\n", key.c_str(), history_arg);
+      writer.Write("return ParseEnum(kProps[index].enum_table, value);\n");
+    } else if (prop.type() == sysprop::EnumList) {
+      writer.Write("std::vector<std::optional<std::string>> values;\n");
+      writer.Write("GetProp(%s, &values%s);\n", key.c_str(), history_arg);
+      writer.Write("%s ret;\n", accessor_type.c_str());
+      writer.Write("ret.reserve(values.size());\n");
+      writer.Write("for (auto&& value : values) {\n");
+      writer.Indent();
+      writer.Write(
+          "ret.push_back(ParseEnum(kProps[index].enum_table, value));\n");
       writer.Dedent();
       writer.Write("}\n");
+      writer.Write("return ret;\n");
+    } else {
+      writer.Write("%s ret;\n", accessor_type.c_str());
+      writer.Write("GetProp(%s, &ret%s);\n", key.c_str(), history_arg);
+      writer.Write("return ret;\n");
+    }
+    writer.Dedent();
+    writer.Write("}\n");
+
+    if (setters.count(accessor_name) == 0) continue;
+
+    writer.Write("\nbool Set%s(std::uint64_t key, const %s& value) {\n",
+                 accessor_name.c_str(), accessor_type.c_str());
+    writer.Indent();
+    writer.Write("std::uint32_t index = GetPropIndex(key);\n");
+    writer.Write("const char* name = GetPropName(index, k%s);\n", type_name);
+    if (prop.type() == sysprop::Enum) {
+      writer.Write(
+          "return __system_property_set(name, value ? "
+          "FormatEnum(kProps[index].enum_table, *value, name) : \"\") == 0;\n");
+    } else if (prop.type() == sysprop::EnumList) {
+      writer.Write(
+          "return __system_property_set(name, "
+          "FormatEnumList(kProps[index].enum_table, value, name).c_str()) == "
+          "0;\n");
+    } else {
+      sysprop::Property format_prop;
+      format_prop.set_type(prop.type());
+      if (integer_as_bool_setters.count(accessor_name) != 0) {
+        format_prop.set_integer_as_bool(true);
+        std::string expr = GetFormattingExpression(format_prop);
+        if (plain_setters.count(accessor_name) != 0) {
+          writer.Write("if (kProps[index].flags & kIntegerAsBool) {\n");
+          writer.Indent();
+          writer.Write("return __system_property_set(name, %s) == 0;\n",
+                       expr.c_str());
+          writer.Dedent();
+          writer.Write("}\n");
+        } else {
+          writer.Write("return __system_property_set(name, %s) == 0;\n",
+                       expr.c_str());
+        }
+        format_prop.set_integer_as_bool(false);
+      }
+      if (plain_setters.count(accessor_name) != 0) {
+        writer.Write("return __system_property_set(name, %s) == 0;\n",
+                     GetFormattingExpression(format_prop).c_str());
+      }
     }
+    writer.Dedent();
+    writer.Write("}\n");
   }
 
-  writer.Write("\n}  // namespace %s\n", cpp_namespace.c_str());
+  bool has_constant_setter = false;
+  for (int i = 0; i < props.prop_size(); ++i) {
+    if (HasConstantSetter(props.prop(i))) has_constant_setter = true;
+  }
+  if (has_constant_setter) {
+    writer.Write(
+        "\nbool SetRawValue(std::uint64_t key, const char* value) {\n");
+    writer.Indent();
+    writer.Write("std::uint32_t index = GetPropIndex(key);\n");
+    writer.Write(
+        "return __system_property_set(kPropNames + kProps[index].name_offset, "
+        "value) == 0;\n");
+    writer.Dedent();
+    writer.Write("}\n");
+  }
+
+  if (has_flags_getter) {
+    writer.Write("\nstd::uint64_t GetEnumFlags(std::uint64_t key) {\n");
+    writer.Indent();
+    writer.Write("std::uint32_t index = GetPropIndex(key);\n");
+    writer.Write("std::optional<std::string> value;\n");
+    writer.Write("GetProp(%s, &value%s);\n",
+                 options.module_registry
+                     ? "FindProp(index, GetPropName(index, kEnumList))"
+                     : "GetPropName(index, kEnumList)",
+                 options.instrumented ? ", &gChangeHistories[index]" : "");
+    writer.Write(
+        "return value ? ParseEnumFlags(kProps[index].enum_table, "
+        "value->c_str()) : 0;\n");
+    writer.Dedent();
+    writer.Write("}\n");
+  }
+
+  if (has_flags_setter) {
+    writer.Write(
+        "\nbool SetEnumFlags(std::uint64_t key, std::uint64_t value) {\n");
+    writer.Indent();
+    writer.Write("std::uint32_t index = GetPropIndex(key);\n");
+    writer.Write("const char* name = GetPropName(index, kEnumList);\n");
+    writer.Write(
+        "return __system_property_set(name, "
+        "FormatEnumFlags(kProps[index].enum_table, value).c_str()) == 0;\n");
+    writer.Dedent();
+    writer.Write("}\n");
+  }
+
+  writer.Write("\n}  // namespace %s::internal\n", cpp_namespace.c_str());
+
+  if (options.instrumented || options.snapshot) {
+    writer.Write("\nnamespace %s {\n\n", cpp_namespace.c_str());
+    if (options.instrumented) WriteGetPropChangeStats(writer, props);
+    if (options.instrumented && options.snapshot) writer.Write("\n");
+    if (options.snapshot) WriteSnapshotFunctions(writer, props);
+    writer.Write("\n}  // namespace %s\n", cpp_namespace.c_str());
+  }
 
   return writer.Code();
 }
@@ -435,7 +2667,12 @@ Result<void> GenerateCppFiles(const std::string& input_file_path,
                               const std::string& header_dir,
                               const std::string& public_header_dir,
                               const std::string& source_output_dir,
-                              const std::string& include_name) {
+                              const std::string& include_name,
+                              const CppGenOptions& options) {
+  if (!options.profile_file.empty() && options.table_driven) {
+    return Errorf("Profiles can't be used with table-driven accessors");
+  }
+
   sysprop::Properties props;
 
   if (auto res = ParseProps(input_file_path); res.ok()) {
@@ -457,15 +2694,38 @@ Result<void> GenerateCppFiles(const std::string& input_file_path,
     }
 
     std::string path = dir + "/" + output_basename + ".h";
-    std::string result = GenerateHeader(props, scope);
+    std::string result = GenerateHeader(props, scope, options);
 
     if (!android::base::WriteStringToFile(result, path)) {
       return ErrnoErrorf("Writing generated header to {} failed", path);
     }
   }
 
+  std::vector<PropAccess> accesses;
+
+  if (!options.profile_file.empty()) {
+    sysprop::AccessProfile profile;
+    if (auto res = ParseAccessProfile(options.profile_file); res.ok()) {
+      profile = std::move(*res);
+    } else {
+      return res.error();
+    }
+
+    accesses = ChooseAccessStrategies(props, profile, true);
+
+    std::string report_path =
+        source_output_dir + "/" + output_basename + ".access.txt";
+    if (!android::base::WriteStringToFile(
+            FormatAccessReport(props, profile, accesses), report_path)) {
+      return ErrnoErrorf("Writing access report to {} failed", report_path);
+    }
+  }
+
   std::string source_path = source_output_dir + "/" + output_basename + ".cpp";
-  std::string source_result = GenerateSource(props, include_name);
+  std::string source_result =
+      options.table_driven
+          ? GenerateTableDrivenSource(props, include_name, options)
+          : GenerateSource(props, include_name, options, accesses);
 
   if (!android::base::WriteStringToFile(source_result, source_path)) {
     return ErrnoErrorf("Writing generated source to {} failed", source_path);
@@ -36,13 +36,15 @@ struct Arguments {
   std::string public_header_dir;
   std::string source_dir;
   std::string include_name;
+  CppGenOptions options;
 };
 
 [[noreturn]] void PrintUsage(const char* exe_name) {
   std::printf(
       "Usage: %s --header-dir dir --source-dir dir "
       "--include-name name --public-header-dir dir "
-      "sysprop_file\n",
+      "[--table-driven] [--instrumented] [--module-registry] [--snapshot] "
+      "[--profile file] sysprop_file\n",
       exe_name);
   std::exit(EXIT_FAILURE);
 }
@@ -55,6 +57,11 @@ Result<Arguments> ParseArgs(int argc, char* argv[]) {
         {"public-header-dir", required_argument, 0, 'p'},
         {"source-dir", required_argument, 0, 'c'},
         {"include-name", required_argument, 0, 'n'},
+        {"table-driven", no_argument, 0, 't'},
+        {"instrumented", no_argument, 0, 'i'},
+        {"module-registry", no_argument, 0, 'r'},
+        {"snapshot", no_argument, 0, 's'},
+        {"profile", required_argument, 0, 'f'},
     };
 
     int opt = getopt_long_only(argc, argv, "", long_options, nullptr);
@@ -73,6 +80,21 @@ Result<Arguments> ParseArgs(int argc, char* argv[]) {
       case 'n':
         ret.include_name = optarg;
         break;
+      case 't':
+        ret.options.table_driven = true;
+        break;
+      case 'i':
+        ret.options.instrumented = true;
+        break;
+      case 'r':
+        ret.options.module_registry = true;
+        break;
+      case 's':
+        ret.options.snapshot = true;
+        break;
+      case 'f':
+        ret.options.profile_file = optarg;
+        break;
       default:
         PrintUsage(argv[0]);
     }
@@ -109,7 +131,7 @@ int main(int argc, char* argv[]) {
 
   if (auto res = GenerateCppFiles(args.input_file_path, args.header_dir,
                                   args.public_header_dir, args.source_dir,
-                                  args.include_name);
+                                  args.include_name, args.options);
       !res.ok()) {
     LOG(FATAL) << "Error during generating cpp sysprop from "
                << args.input_file_path << ": " << res.error();
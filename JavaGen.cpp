@@ -26,6 +26,7 @@
 #include <filesystem>
 #include <regex>
 #include <string>
+#include <vector>
 
 #include "CodeWriter.h"
 #include "Common.h"
@@ -42,11 +43,14 @@ constexpr const char* kJavaFileImports =
 
 import java.lang.StringBuilder;
 import java.util.ArrayList;
+import java.util.EnumSet;
 import java.util.function.Function;
 import java.util.List;
 import java.util.Locale;
+import java.util.Map;
 import java.util.Optional;
 import java.util.StringJoiner;
+import java.util.TreeMap;
 import java.util.stream.Collectors;
 
 )";
@@ -134,6 +138,41 @@ private static <T extends Enum<T>> List<T> tryParseEnumList(Class<T> enumType, S
     return ret;
 }
 
+private static <T extends Enum<T>> EnumSet<T> tryParseEnumSet(Class<T> enumType, String str) {
+    EnumSet<T> ret = EnumSet.noneOf(enumType);
+    if ("".equals(str)) return ret;
+
+    for (String element : str.split(",")) {
+        T value = tryParseEnum(enumType, element);
+        if (value != null) ret.add(value);
+    }
+
+    return ret;
+}
+
+private static <T> Map<String, T> tryParseMap(Function<String, T> valueParser, String str) {
+    Map<String, T> ret = new TreeMap<>();
+
+    int p = 0;
+    while (p < str.length()) {
+        StringBuilder key = new StringBuilder();
+        StringBuilder value = new StringBuilder();
+        StringBuilder token = key;
+        for (; p < str.length() && str.charAt(p) != ','; ++p) {
+            if (str.charAt(p) == '=' && token == key) {
+                token = value;
+                continue;
+            }
+            if (str.charAt(p) == '\\' && p + 1 < str.length()) ++p;
+            token.append(str.charAt(p));
+        }
+        ++p;
+        ret.put(key.toString(), valueParser.apply(value.toString()));
+    }
+
+    return ret;
+}
+
 private static String escape(String str) {
     return str.replaceAll("([\\\\,])", "\\\\$1");
 }
@@ -148,7 +187,23 @@ private static <T> String formatList(List<T> list) {
     return joiner.toString();
 }
 
-private static <T extends Enum<T>> String formatEnumList(List<T> list, Function<T, String> elementFormatter) {
+private static String escapeMapToken(String str) {
+    return str.replaceAll("([\\\\,=])", "\\\\$1");
+}
+
+private static <T> String formatMap(Map<String, T> map) {
+    StringJoiner joiner = new StringJoiner(",");
+
+    for (Map.Entry<String, T> entry : map.entrySet()) {
+        T value = entry.getValue();
+        joiner.add(escapeMapToken(entry.getKey()) + "="
+                + (value == null ? "" : escapeMapToken(value.toString())));
+    }
+
+    return joiner.toString();
+}
+
+private static <T extends Enum<T>> String formatEnumList(Iterable<T> list, Function<T, String> elementFormatter) {
     StringJoiner joiner = new StringJoiner(",");
 
     for (T element : list) {
@@ -164,17 +219,78 @@ const std::regex kRegexUnderscore{"_"};
 
 std::string GetJavaTypeName(const sysprop::Property& prop);
 std::string GetJavaEnumTypeName(const sysprop::Property& prop);
+std::string GetJavaStructTypeName(const sysprop::Property& prop);
+std::string GetJavaPrimitiveTypeName(sysprop::Type type);
+std::string GetJavaStructFieldTypeName(const sysprop::StructField& field);
+std::string GetStructFieldParsingExpression(const sysprop::StructField& field,
+                                            const std::string& value);
 std::string GetJavaPackageName(const sysprop::Properties& props);
 std::string GetJavaClassName(const sysprop::Properties& props);
 std::string GetParsingExpression(const sysprop::Property& prop);
 std::string GetFormattingExpression(const sysprop::Property& prop);
+void WriteJavaEnum(CodeWriter& writer, const std::string& enum_name,
+                   const std::string& enum_values);
+void WriteJavaStruct(CodeWriter& writer, const sysprop::Property& prop);
+void WriteJavaEnumFlagsAccessors(CodeWriter& writer,
+                                 const sysprop::Property& prop,
+                                 AccessStrategy strategy);
+void WriteJavaAccessFields(CodeWriter& writer, const sysprop::Property& prop,
+                           AccessStrategy strategy);
+void WriteJavaValueRead(CodeWriter& writer, const sysprop::Property& prop,
+                        AccessStrategy strategy);
+void WriteJavaGetterReturn(CodeWriter& writer, const sysprop::Property& prop,
+                           AccessStrategy strategy, const std::string& type,
+                           const std::string& parsed, const std::string& memo,
+                           const std::string& copy);
+bool IsPreloadedProp(const sysprop::Property& prop);
+void WriteJavaPreload(CodeWriter& writer, const sysprop::Properties& props,
+                      sysprop::Scope scope);
 std::string GenerateJavaClass(const sysprop::Properties& props,
-                              sysprop::Scope scope);
+                              sysprop::Scope scope,
+                              const std::vector<PropAccess>& accesses,
+                              const JavaGenOptions& options);
 
 std::string GetJavaEnumTypeName(const sysprop::Property& prop) {
   return ApiNameToIdentifier(prop.api_name()) + "_values";
 }
 
+std::string GetJavaStructTypeName(const sysprop::Property& prop) {
+  return ApiNameToIdentifier(prop.api_name()) + "_values";
+}
+
+std::string GetJavaPrimitiveTypeName(sysprop::Type type) {
+  switch (type) {
+    case sysprop::Boolean:
+      return "Boolean";
+    case sysprop::Integer:
+      return "Integer";
+    case sysprop::Long:
+      return "Long";
+    case sysprop::Double:
+      return "Double";
+    case sysprop::String:
+      return "String";
+    default:
+      __builtin_unreachable();
+  }
+}
+
+// Enums of struct fields are nested in the struct.
+std::string GetJavaStructFieldTypeName(const sysprop::StructField& field) {
+  if (field.type() == sysprop::Enum) return field.name() + "_values";
+  return GetJavaPrimitiveTypeName(field.type());
+}
+
+std::string GetStructFieldParsingExpression(const sysprop::StructField& field,
+                                            const std::string& value) {
+  if (field.type() == sysprop::Enum) {
+    return "tryParseEnum(" + GetJavaStructFieldTypeName(field) + ".class, " +
+           value + ")";
+  }
+  return "tryParse" + GetJavaPrimitiveTypeName(field.type()) + "(" + value +
+         ")";
+}
+
 std::string GetJavaTypeName(const sysprop::Property& prop) {
   switch (prop.type()) {
     case sysprop::Boolean:
@@ -189,6 +305,8 @@ std::string GetJavaTypeName(const sysprop::Property& prop) {
       return "String";
     case sysprop::Enum:
       return GetJavaEnumTypeName(prop);
+    case sysprop::Struct:
+      return GetJavaStructTypeName(prop);
     case sysprop::BooleanList:
       return "List<Boolean>";
     case sysprop::IntegerList:
@@ -201,6 +319,16 @@ std::string GetJavaTypeName(const sysprop::Property& prop) {
       return "List<String>";
     case sysprop::EnumList:
       return "List<" + GetJavaEnumTypeName(prop) + ">";
+    case sysprop::BooleanMap:
+      return "Map<String, Boolean>";
+    case sysprop::IntegerMap:
+      return "Map<String, Integer>";
+    case sysprop::LongMap:
+      return "Map<String, Long>";
+    case sysprop::DoubleMap:
+      return "Map<String, Double>";
+    case sysprop::StringMap:
+      return "Map<String, String>";
     default:
       __builtin_unreachable();
   }
@@ -224,34 +352,42 @@ std::string GetParsingExpression(const sysprop::Property& prop) {
       return "tryParseEnumList(" + GetJavaEnumTypeName(prop) +
              ".class, "
              "value)";
+    case sysprop::Struct:
+      return GetJavaStructTypeName(prop) + ".tryParse(value)";
     default:
       break;
   }
 
   // The remaining cases are lists for types other than Enum which share the
-  // same parsing function "tryParseList"
+  // same parsing function "tryParseList", and maps which share "tryParseMap"
   std::string element_parser;
 
   switch (prop.type()) {
     case sysprop::BooleanList:
+    case sysprop::BooleanMap:
       element_parser = "v -> tryParseBoolean(v)";
       break;
     case sysprop::IntegerList:
+    case sysprop::IntegerMap:
       element_parser = "v -> tryParseInteger(v)";
       break;
     case sysprop::LongList:
+    case sysprop::LongMap:
       element_parser = "v -> tryParseLong(v)";
       break;
     case sysprop::DoubleList:
+    case sysprop::DoubleMap:
       element_parser = "v -> tryParseDouble(v)";
       break;
     case sysprop::StringList:
+    case sysprop::StringMap:
       element_parser = "v -> tryParseString(v)";
       break;
     default:
       __builtin_unreachable();
   }
 
+  if (IsMapProp(prop)) return "tryParseMap(" + element_parser + ", value)";
   return "tryParseList(" + element_parser + ", value)";
 }
 
@@ -266,13 +402,15 @@ std::string GetFormattingExpression(const sysprop::Property& prop) {
              "x -> x == null ? \"\" : (x ? \"1\" : \"0\"))"
              ".collect(Collectors.joining(\",\"))";
     }
-  } else if (prop.type() == sysprop::Enum) {
+  } else if (prop.type() == sysprop::Enum || prop.type() == sysprop::Struct) {
     return "value.getPropValue()";
   } else if (prop.type() == sysprop::EnumList) {
     return "formatEnumList(value, " + GetJavaEnumTypeName(prop) +
            "::getPropValue)";
   } else if (IsListProp(prop)) {
     return "formatList(value)";
+  } else if (IsMapProp(prop)) {
+    return "formatMap(value)";
   } else {
     return "value.toString()";
   }
@@ -288,8 +426,295 @@ std::string GetJavaClassName(const sysprop::Properties& props) {
   return module.substr(module.rfind('.') + 1);
 }
 
+void WriteJavaEnum(CodeWriter& writer, const std::string& enum_name,
+                   const std::string& enum_values) {
+  writer.Write("public static enum %s {\n", enum_name.c_str());
+  writer.Indent();
+  std::vector<std::string> values = android::base::Split(enum_values, "|");
+  for (int i = 0; i < values.size(); ++i) {
+    const std::string& name = values[i];
+    writer.Write("%s(\"%s\")", ToUpper(name).c_str(), name.c_str());
+    if (i + 1 < values.size()) {
+      writer.Write(",\n");
+    } else {
+      writer.Write(";\n");
+    }
+  }
+  writer.Write(
+      "private final String propValue;\n"
+      "private %s(String propValue) {\n",
+      enum_name.c_str());
+  writer.Indent();
+  writer.Write("this.propValue = propValue;\n");
+  writer.Dedent();
+  writer.Write(
+      "}\n"
+      "public String getPropValue() {\n");
+  writer.Indent();
+  writer.Write("return propValue;\n");
+  writer.Dedent();
+  writer.Write("}\n");
+  writer.Dedent();
+  writer.Write("}\n");
+}
+
+// Struct fields are encoded in one value in order, separated by commas and
+// escaped like list elements.
+void WriteJavaStruct(CodeWriter& writer, const sysprop::Property& prop) {
+  std::string struct_name = GetJavaStructTypeName(prop);
+  int field_count = prop.struct_fields_size();
+
+  writer.Write("public static final class %s {\n", struct_name.c_str());
+  writer.Indent();
+
+  for (const sysprop::StructField& field : prop.struct_fields()) {
+    if (field.type() != sysprop::Enum) continue;
+    WriteJavaEnum(writer, GetJavaStructFieldTypeName(field),
+                  field.enum_values());
+    writer.Write("\n");
+  }
+
+  for (const sysprop::StructField& field : prop.struct_fields()) {
+    writer.Write("public final %s %s;\n",
+                 GetJavaStructFieldTypeName(field).c_str(),
+                 field.name().c_str());
+  }
+
+  writer.Write("\npublic %s(", struct_name.c_str());
+  for (int i = 0; i < field_count; ++i) {
+    const sysprop::StructField& field = prop.struct_fields(i);
+    writer.Write("%s%s %s", i > 0 ? ", " : "",
+                 GetJavaStructFieldTypeName(field).c_str(),
+                 field.name().c_str());
+  }
+  writer.Write(") {\n");
+  writer.Indent();
+  for (const sysprop::StructField& field : prop.struct_fields()) {
+    writer.Write("this.%s = %s;\n", field.name().c_str(),
+                 field.name().c_str());
+  }
+  writer.Dedent();
+  writer.Write("}\n\n");
+
+  writer.Write("private static %s tryParse(String str) {\n",
+               struct_name.c_str());
+  writer.Indent();
+  writer.Write("if (\"\".equals(str)) return null;\n");
+  writer.Write("List<String> fields = tryParseList(v -> v, str);\n");
+  writer.Write("return new %s(\n", struct_name.c_str());
+  writer.Indent();
+  writer.Indent();
+  for (int i = 0; i < field_count; ++i) {
+    const sysprop::StructField& field = prop.struct_fields(i);
+    std::string field_value = "fields.get(" + std::to_string(i) + ")";
+    writer.Write("fields.size() > %d ? %s : null%s\n", i,
+                 GetStructFieldParsingExpression(field, field_value).c_str(),
+                 i + 1 < field_count ? "," : ");");
+  }
+  writer.Dedent();
+  writer.Dedent();
+  writer.Dedent();
+  writer.Write("}\n\n");
+
+  writer.Write("public String getPropValue() {\n");
+  writer.Indent();
+  writer.Write("StringJoiner joiner = new StringJoiner(\",\");\n");
+  for (const sysprop::StructField& field : prop.struct_fields()) {
+    const char* name = field.name().c_str();
+    std::string format_expr;
+    switch (field.type()) {
+      case sysprop::Enum:
+        format_expr = field.name() + ".getPropValue()";
+        break;
+      case sysprop::String:
+        format_expr = "escape(" + field.name() + ")";
+        break;
+      default:
+        format_expr = field.name() + ".toString()";
+        break;
+    }
+    writer.Write("joiner.add(%s == null ? \"\" : %s);\n", name,
+                 format_expr.c_str());
+  }
+  writer.Write("return joiner.toString();\n");
+  writer.Dedent();
+  writer.Write("}\n");
+
+  writer.Dedent();
+  writer.Write("}\n");
+}
+
+// The flags getter shares the handle of the list getter, but memoizes its own
+// value.
+void WriteJavaEnumFlagsAccessors(CodeWriter& writer,
+                                 const sysprop::Property& prop,
+                                 AccessStrategy strategy) {
+  std::string prop_id = ApiNameToIdentifier(prop.api_name());
+  std::string enum_name = GetJavaEnumTypeName(prop);
+  std::string flags_type = "EnumSet<" + enum_name + ">";
+
+  writer.Write("\n");
+  if (strategy == AccessStrategy::kMemoize) {
+    writer.Write("private static volatile %s %s_flags_value;\n\n",
+                 flags_type.c_str(), prop_id.c_str());
+  }
+  if (prop.deprecated()) writer.Write("@Deprecated\n");
+  writer.Write("public static %s %s_flags() {\n", flags_type.c_str(),
+               prop_id.c_str());
+  writer.Indent();
+  WriteJavaGetterReturn(writer, prop, strategy, flags_type,
+                        "tryParseEnumSet(" + enum_name + ".class, value)",
+                        prop_id + "_flags_value", "EnumSet.copyOf");
+  writer.Dedent();
+  writer.Write("}\n");
+
+  if (prop.access() == sysprop::Readonly) return;
+
+  writer.Write("\n");
+  if (prop.deprecated()) writer.Write("@Deprecated\n");
+  writer.Write("public static void %s_flags(EnumSet<%s> value) {\n",
+               prop_id.c_str(), enum_name.c_str());
+  writer.Indent();
+  writer.Write(
+      "SystemProperties.set(\"%s\", value == null ? \"\" : "
+      "formatEnumList(value, %s::getPropValue));\n",
+      prop.prop_name().c_str(), enum_name.c_str());
+  writer.Dedent();
+  writer.Write("}\n");
+}
+
+// Java has no serial caches, so profiled getters either keep the handle of
+// their property or memoize the parsed value of an ro. property once it is
+// set.
+void WriteJavaAccessFields(CodeWriter& writer, const sysprop::Property& prop,
+                           AccessStrategy strategy) {
+  std::string prop_id = ApiNameToIdentifier(prop.api_name());
+  if (strategy == AccessStrategy::kCachedHandle) {
+    writer.Write("private static volatile SystemProperties.Handle %s_handle;\n",
+                 prop_id.c_str());
+  } else if (strategy == AccessStrategy::kMemoize) {
+    std::string prop_type = GetJavaTypeName(prop);
+    if (!IsListProp(prop) && !IsMapProp(prop)) {
+      prop_type = "Optional<" + prop_type + ">";
+    }
+    writer.Write("private static volatile %s %s_value;\n", prop_type.c_str(),
+                 prop_id.c_str());
+  }
+}
+
+void WriteJavaValueRead(CodeWriter& writer, const sysprop::Property& prop,
+                        AccessStrategy strategy) {
+  std::string prop_id = ApiNameToIdentifier(prop.api_name());
+  switch (strategy) {
+    case AccessStrategy::kCachedHandle:
+      writer.Write("SystemProperties.Handle handle = %s_handle;\n",
+                   prop_id.c_str());
+      writer.Write("if (handle == null) {\n");
+      writer.Indent();
+      writer.Write("handle = SystemProperties.find(\"%s\");\n",
+                   prop.prop_name().c_str());
+      writer.Write("%s_handle = handle;\n", prop_id.c_str());
+      writer.Dedent();
+      writer.Write("}\n");
+      writer.Write("String value = handle == null ? \"\" : handle.get();\n");
+      break;
+    default:
+      writer.Write("String value = SystemProperties.get(\"%s\");\n",
+                   prop.prop_name().c_str());
+      break;
+  }
+}
+
+// Reads the property and returns `parsed`, a `type` parsed from `value`.
+// Memoized values are kept in the `memo` field. Types which callers could
+// modify are passed through `copy`, e.g. "new ArrayList<>", so that callers
+// don't share the memoized value.
+void WriteJavaGetterReturn(CodeWriter& writer, const sysprop::Property& prop,
+                           AccessStrategy strategy, const std::string& type,
+                           const std::string& parsed, const std::string& memo,
+                           const std::string& copy) {
+  if (strategy != AccessStrategy::kMemoize) {
+    WriteJavaValueRead(writer, prop, strategy);
+    writer.Write("return %s;\n", parsed.c_str());
+    return;
+  }
+
+  auto copy_of = [&](const std::string& var) {
+    return copy.empty() ? var : copy + "(" + var + ")";
+  };
+  writer.Write("%s memo = %s;\n", type.c_str(), memo.c_str());
+  writer.Write("if (memo != null) return %s;\n", copy_of("memo").c_str());
+  WriteJavaValueRead(writer, prop, strategy);
+  writer.Write("%s ret = %s;\n", type.c_str(), parsed.c_str());
+  writer.Write("// ro. properties never change once they are set.\n");
+  writer.Write("if (!value.isEmpty()) %s = %s;\n", memo.c_str(),
+               copy_of("ret").c_str());
+  writer.Write("return ret;\n");
+}
+
+// ro. properties can't change once they are set, so preload() parses the
+// Readonly ones into final fields. Properties which are still unset are left
+// null and read as usual.
+bool IsPreloadedProp(const sysprop::Property& prop) {
+  return prop.access() == sysprop::Readonly &&
+         android::base::StartsWith(prop.prop_name(), "ro.");
+}
+
+void WriteJavaPreload(CodeWriter& writer, const sysprop::Properties& props,
+                      sysprop::Scope scope) {
+  std::vector<const sysprop::Property*> preloaded;
+  for (const sysprop::Property& prop : props.prop()) {
+    if (prop.scope() <= scope && IsPreloadedProp(prop)) {
+      preloaded.push_back(&prop);
+    }
+  }
+
+  writer.Write("\n");
+  if (preloaded.empty()) {
+    writer.Write("public static void preload() {}\n");
+    return;
+  }
+
+  writer.Write("private static final class Preloaded {\n");
+  writer.Indent();
+  for (const sysprop::Property* prop : preloaded) {
+    std::string prop_type = GetJavaTypeName(*prop);
+    if (!IsListProp(*prop) && !IsMapProp(*prop)) {
+      prop_type = "Optional<" + prop_type + ">";
+    }
+    writer.Write("final %s %s;\n", prop_type.c_str(),
+                 ApiNameToIdentifier(prop->api_name()).c_str());
+  }
+  writer.Write("\nPreloaded() {\n");
+  writer.Indent();
+  writer.Write("String value;\n");
+  for (const sysprop::Property* prop : preloaded) {
+    std::string parsed = GetParsingExpression(*prop);
+    if (!IsListProp(*prop) && !IsMapProp(*prop)) {
+      parsed = "Optional.ofNullable(" + parsed + ")";
+    }
+    writer.Write("value = SystemProperties.get(\"%s\");\n",
+                 prop->prop_name().c_str());
+    writer.Write("%s = value.isEmpty() ? null : %s;\n",
+                 ApiNameToIdentifier(prop->api_name()).c_str(), parsed.c_str());
+  }
+  writer.Dedent();
+  writer.Write("}\n");
+  writer.Dedent();
+  writer.Write("}\n\n");
+
+  writer.Write("private static volatile Preloaded preloaded;\n\n");
+  writer.Write("public static void preload() {\n");
+  writer.Indent();
+  writer.Write("preloaded = new Preloaded();\n");
+  writer.Dedent();
+  writer.Write("}\n");
+}
+
 std::string GenerateJavaClass(const sysprop::Properties& props,
-                              sysprop::Scope scope) {
+                              sysprop::Scope scope,
+                              const std::vector<PropAccess>& accesses,
+                              const JavaGenOptions& options) {
   std::string package_name = GetJavaPackageName(props);
   std::string class_name = GetJavaClassName(props);
 
@@ -314,59 +739,60 @@ std::string GenerateJavaClass(const sysprop::Properties& props,
     std::string prop_type = GetJavaTypeName(prop);
 
     if (prop.type() == sysprop::Enum || prop.type() == sysprop::EnumList) {
-      writer.Write("public static enum %s {\n",
-                   GetJavaEnumTypeName(prop).c_str());
-      writer.Indent();
-      std::vector<std::string> values =
-          android::base::Split(prop.enum_values(), "|");
-      for (int i = 0; i < values.size(); ++i) {
-        const std::string& name = values[i];
-        writer.Write("%s(\"%s\")", ToUpper(name).c_str(), name.c_str());
-        if (i + 1 < values.size()) {
-          writer.Write(",\n");
-        } else {
-          writer.Write(";\n");
-        }
-      }
-      writer.Write(
-          "private final String propValue;\n"
-          "private %s(String propValue) {\n",
-          GetJavaEnumTypeName(prop).c_str());
-      writer.Indent();
-      writer.Write("this.propValue = propValue;\n");
-      writer.Dedent();
-      writer.Write(
-          "}\n"
-          "public String getPropValue() {\n");
-      writer.Indent();
-      writer.Write("return propValue;\n");
-      writer.Dedent();
-      writer.Write("}\n");
-      writer.Dedent();
-      writer.Write("}\n\n");
+      WriteJavaEnum(writer, GetJavaEnumTypeName(prop), prop.enum_values());
+      writer.Write("\n");
+    } else if (prop.type() == sysprop::Struct) {
+      WriteJavaStruct(writer, prop);
+      writer.Write("\n");
+    }
+
+    AccessStrategy strategy =
+        accesses.empty() ? AccessStrategy::kPlain : accesses[i].strategy;
+    if (strategy != AccessStrategy::kPlain) {
+      WriteJavaAccessFields(writer, prop, strategy);
+      writer.Write("\n");
     }
 
     if (prop.deprecated()) {
       writer.Write("@Deprecated\n");
     }
 
-    if (IsListProp(prop)) {
+    if (IsListProp(prop) || IsMapProp(prop)) {
       writer.Write("public static %s %s() {\n", prop_type.c_str(),
                    prop_id.c_str());
       writer.Indent();
-      writer.Write("String value = SystemProperties.get(\"%s\");\n",
-                   prop.prop_name().c_str());
-      writer.Write("return %s;\n", GetParsingExpression(prop).c_str());
+      if (options.preload && IsPreloadedProp(prop)) {
+        // Lists and maps are mutable, so callers get their own copies.
+        writer.Write("Preloaded cache = preloaded;\n");
+        writer.Write("if (cache != null && cache.%s != null) {\n",
+                     prop_id.c_str());
+        writer.Indent();
+        writer.Write("return new %s<>(cache.%s);\n",
+                     IsMapProp(prop) ? "TreeMap" : "ArrayList",
+                     prop_id.c_str());
+        writer.Dedent();
+        writer.Write("}\n");
+      }
+      WriteJavaGetterReturn(
+          writer, prop, strategy, prop_type, GetParsingExpression(prop),
+          prop_id + "_value",
+          IsMapProp(prop) ? "new TreeMap<>" : "new ArrayList<>");
       writer.Dedent();
       writer.Write("}\n");
     } else {
       writer.Write("public static Optional<%s> %s() {\n", prop_type.c_str(),
                    prop_id.c_str());
       writer.Indent();
-      writer.Write("String value = SystemProperties.get(\"%s\");\n",
-                   prop.prop_name().c_str());
-      writer.Write("return Optional.ofNullable(%s);\n",
-                   GetParsingExpression(prop).c_str());
+      if (options.preload && IsPreloadedProp(prop)) {
+        writer.Write("Preloaded cache = preloaded;\n");
+        writer.Write(
+            "if (cache != null && cache.%s != null) return cache.%s;\n",
+            prop_id.c_str(), prop_id.c_str());
+      }
+      WriteJavaGetterReturn(
+          writer, prop, strategy, "Optional<" + prop_type + ">",
+          "Optional.ofNullable(" + GetParsingExpression(prop) + ")",
+          prop_id + "_value", "");
       writer.Dedent();
       writer.Write("}\n");
     }
@@ -385,8 +811,14 @@ std::string GenerateJavaClass(const sysprop::Properties& props,
       writer.Dedent();
       writer.Write("}\n");
     }
+
+    if (HasEnumFlags(prop)) {
+      WriteJavaEnumFlagsAccessors(writer, prop, strategy);
+    }
   }
 
+  if (options.preload) WriteJavaPreload(writer, props, scope);
+
   writer.Dedent();
   writer.Write("}\n");
 
@@ -397,7 +829,8 @@ std::string GenerateJavaClass(const sysprop::Properties& props,
 
 Result<void> GenerateJavaLibrary(const std::string& input_file_path,
                                  sysprop::Scope scope,
-                                 const std::string& java_output_dir) {
+                                 const std::string& java_output_dir,
+                                 const JavaGenOptions& options) {
   sysprop::Properties props;
 
   if (auto res = ParseProps(input_file_path); res.ok()) {
@@ -406,7 +839,19 @@ Result<void> GenerateJavaLibrary(const std::string& input_file_path,
     return res.error();
   }
 
-  std::string java_result = GenerateJavaClass(props, scope);
+  sysprop::AccessProfile profile;
+  std::vector<PropAccess> accesses;
+
+  if (!options.profile_file.empty()) {
+    if (auto res = ParseAccessProfile(options.profile_file); res.ok()) {
+      profile = std::move(*res);
+    } else {
+      return res.error();
+    }
+    accesses = ChooseAccessStrategies(props, profile, false);
+  }
+
+  std::string java_result = GenerateJavaClass(props, scope, accesses, options);
   std::string package_name = GetJavaPackageName(props);
   std::string java_package_dir =
       java_output_dir + "/" + std::regex_replace(package_name, kRegexDot, "/");
@@ -425,5 +870,14 @@ Result<void> GenerateJavaLibrary(const std::string& input_file_path,
                        java_output_file);
   }
 
+  if (!options.profile_file.empty()) {
+    std::string report_file =
+        java_package_dir + "/" + class_name + ".access.txt";
+    if (!android::base::WriteStringToFile(
+            FormatAccessReport(props, profile, accesses), report_file)) {
+      return ErrnoErrorf("Writing access report to {} failed", report_file);
+    }
+  }
+
   return {};
 }
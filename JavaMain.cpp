@@ -35,12 +35,13 @@ struct Arguments {
   std::string input_file_path;
   std::string java_output_dir;
   sysprop::Scope scope;
+  JavaGenOptions options;
 };
 
 [[noreturn]] void PrintUsage(const char* exe_name) {
   std::printf(
       "Usage: %s --scope (internal|public) --java-output-dir dir "
-      "sysprop_file\n",
+      "[--profile file] [--preload] sysprop_file\n",
       exe_name);
   std::exit(EXIT_FAILURE);
 }
@@ -50,6 +51,8 @@ Result<void> ParseArgs(int argc, char* argv[], Arguments* args) {
     static struct option long_options[] = {
         {"java-output-dir", required_argument, 0, 'j'},
         {"scope", required_argument, 0, 's'},
+        {"profile", required_argument, 0, 'f'},
+        {"preload", no_argument, 0, 'p'},
     };
 
     int opt = getopt_long_only(argc, argv, "", long_options, nullptr);
@@ -68,6 +71,12 @@ Result<void> ParseArgs(int argc, char* argv[], Arguments* args) {
           return Errorf("Invalid option {} for scope", optarg);
         }
         break;
+      case 'f':
+        args->options.profile_file = optarg;
+        break;
+      case 'p':
+        args->options.preload = true;
+        break;
       default:
         PrintUsage(argv[0]);
     }
@@ -98,7 +107,7 @@ int main(int argc, char* argv[]) {
   }
 
   if (auto res = GenerateJavaLibrary(args.input_file_path, args.scope,
-                                     args.java_output_dir);
+                                     args.java_output_dir, args.options);
       !res.ok()) {
     LOG(FATAL) << "Error during generating java sysprop from "
                << args.input_file_path << ": " << res.error();
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2026 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Writes synthetic sysprop modules for the compile-time benchmark.
+
+Each module uses a few property types, chosen deterministically from its
+index, so that modules differ in which parsers and formatters they need.
+"""
+
+import argparse
+import os
+
+TYPES = [
+    "Boolean", "Integer", "Long", "Double", "String", "IntegerList",
+    "StringList"
+]
+
+
+def write_module(path, index, props):
+  with open(path, "w") as f:
+    f.write("owner: Platform\n")
+    f.write('module: "android.bench.M%d"\n' % index)
+    for p in range(1, props + 1):
+      prop_type = TYPES[(index + p) % 3 + index % 5]
+      f.write('prop {\n'
+              '    api_name: "p%d"\n'
+              '    type: %s\n'
+              '    scope: Public\n'
+              '    access: ReadWrite\n'
+              '    prop_name: "bench.m%d.p%d"\n'
+              '}\n' % (p, prop_type, index, p))
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument("out_dir", help="directory to write M<n>.sysprop to")
+  parser.add_argument("--modules", type=int, default=40)
+  parser.add_argument("--props", type=int, default=10,
+                      help="properties per module")
+  args = parser.parse_args()
+
+  os.makedirs(args.out_dir, exist_ok=True)
+  for m in range(1, args.modules + 1):
+    write_module(os.path.join(args.out_dir, "M%d.sysprop" % m), m, args.props)
+
+
+if __name__ == "__main__":
+  main()
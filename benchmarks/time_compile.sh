@@ -0,0 +1,62 @@
+#!/bin/bash
+#
+# Copyright (C) 2026 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Generates C++ for the synthetic modules with the given sysprop_cpp binary,
+# then reports the time spent compiling the generated sources and their total
+# .text size. See README.md.
+#
+# usage: time_compile.sh <sysprop_cpp> [extra sysprop_cpp flags...]
+#
+# CXX and CXXFLAGS are honored; CXXFLAGS must make libbase, liblog and
+# <sys/system_properties.h> visible to the compiler.
+
+set -e
+
+if [ $# -lt 1 ]; then
+  echo "usage: $0 <sysprop_cpp> [extra sysprop_cpp flags...]" >&2
+  exit 1
+fi
+
+generator=$1
+shift
+CXX=${CXX:-clang++}
+MODULES=${MODULES:-40}
+PROPS=${PROPS:-10}
+
+work=$(mktemp -d)
+trap 'rm -rf "${work}"' EXIT
+mkdir -p "${work}/inc/bench" "${work}/pub" "${work}/src"
+
+python3 "$(dirname "$0")/gen_modules.py" "${work}/in" \
+    --modules "${MODULES}" --props "${PROPS}"
+for f in "${work}"/in/*.sysprop; do
+  "${generator}" --header-dir "${work}/inc/bench" \
+      --public-header-dir "${work}/pub" --source-dir "${work}/src" \
+      --include-name "bench/$(basename "${f}").h" "$@" "${f}"
+done
+
+start=$(date +%s.%N)
+for src in "${work}"/src/*.cpp; do
+  ${CXX} -std=c++17 -O2 ${CXXFLAGS} -I"${work}/inc" -c "${src}" \
+      -o "${src%.cpp}.o"
+done
+end=$(date +%s.%N)
+
+text=$(size -t "${work}"/src/*.o | tail -1 | awk '{print $1}')
+awk -v name="$(basename "${generator}")" -v modules="${MODULES}" \
+    -v start="${start}" -v end="${end}" -v text="${text}" \
+    'BEGIN { printf "%s: %d modules compiled in %.2f s, .text %d bytes\n",
+             name, modules, end - start, text }'
@@ -18,6 +18,7 @@
 
 #include <android-base/result.h>
 #include <string>
+#include <vector>
 #include "sysprop.pb.h"
 
 inline static constexpr const char* kGeneratedFileFooterComments =
@@ -26,8 +27,31 @@ inline static constexpr const char* kGeneratedFileFooterComments =
 std::string ApiNameToIdentifier(const std::string& name);
 std::string GetModuleName(const sysprop::Properties& props);
 bool IsListProp(const sysprop::Property& prop);
+bool IsMapProp(const sysprop::Property& prop);
+bool HasEnumFlags(const sysprop::Property& prop);
 android::base::Result<sysprop::Properties> ParseProps(
     const std::string& file_path);
 android::base::Result<sysprop::SyspropLibraryApis> ParseApiFile(
     const std::string& file_path);
 std::string ToUpper(std::string str);
+
+enum class AccessStrategy {
+  kPlain,
+  kCachedHandle,
+  kSerialCache,
+  kMemoize,
+};
+
+struct PropAccess {
+  AccessStrategy strategy = AccessStrategy::kPlain;
+  std::string reason;
+};
+
+android::base::Result<sysprop::AccessProfile> ParseAccessProfile(
+    const std::string& file_path);
+std::vector<PropAccess> ChooseAccessStrategies(
+    const sysprop::Properties& props, const sysprop::AccessProfile& profile,
+    bool has_serial_cache);
+std::string FormatAccessReport(const sysprop::Properties& props,
+                               const sysprop::AccessProfile& profile,
+                               const std::vector<PropAccess>& accesses);
@@ -19,7 +19,28 @@
 #include <android-base/result.h>
 #include <string>
 
+struct CppGenOptions {
+  // Emit a static descriptor table and one accessor per type, with thin
+  // inline wrappers in the header, instead of one accessor per property.
+  bool table_driven = false;
+  // Record the property changes observed by getters into a ring buffer per
+  // property, and emit GetPropChangeStats() to report change rates.
+  bool instrumented = false;
+  // Cache property handles, and register them with libsysprop_registry so
+  // that ::sysprop::ResolveAllModules() can resolve the handles of all loaded
+  // modules in one pass. Generated sources must link libsysprop_registry.
+  // Reads which skip a lookup are only counted with `instrumented`.
+  bool module_registry = false;
+  // Emit a Snapshot of all properties with binary serialization, so that a
+  // process can read the properties once and pass them to its children.
+  bool snapshot = false;
+  // Path of an AccessProfile in text format. When set, each getter gets an
+  // access strategy chosen from the profile, and the choices are written to
+  // a report next to the source.
+  std::string profile_file;
+};
+
 android::base::Result<void> GenerateCppFiles(
     const std::string& input_file_path, const std::string& header_dir,
     const std::string& public_header_dir, const std::string& source_output_dir,
-    const std::string& include_name);
\ No newline at end of file
+    const std::string& include_name, const CppGenOptions& options = {});
\ No newline at end of file
@@ -21,6 +21,17 @@
 
 #include "sysprop.pb.h"
 
+struct JavaGenOptions {
+  // Path of an AccessProfile in text format. When set, each getter gets an
+  // access strategy chosen from the profile, and the choices are written to
+  // a report next to the class.
+  std::string profile_file;
+  // Emit a static preload() which parses the Readonly ro. properties into
+  // final fields, e.g. during zygote preload, so that forked processes share
+  // the parsed values instead of reading them again.
+  bool preload = false;
+};
+
 android::base::Result<void> GenerateJavaLibrary(
     const std::string& input_file_path, sysprop::Scope scope,
-    const std::string& java_output_dir);
\ No newline at end of file
+    const std::string& java_output_dir, const JavaGenOptions& options = {});
\ No newline at end of file
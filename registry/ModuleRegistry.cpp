@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sysprop/ModuleRegistry.h>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace sysprop {
+
+namespace {
+
+struct Registry {
+  std::mutex lock;
+  std::vector<const ModuleDescriptor*> modules;
+};
+
+// Never destroyed, as modules unregister from static destructors which may run
+// after the ones of this library.
+Registry& GetRegistry() {
+  static Registry* registry = new Registry;
+  return *registry;
+}
+
+// The lock is held while visiting, so that a module can't be unloaded while
+// its handles are being resolved.
+ModuleRegistryStats VisitModules(bool resolve) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+
+  ModuleRegistryStats stats{};
+  for (const ModuleDescriptor* module : registry.modules) {
+    ++stats.modules;
+    stats.props += module->prop_count;
+    if (module->saved_lookups != nullptr) {
+      stats.saved_lookups +=
+          module->saved_lookups->load(std::memory_order_relaxed);
+    }
+    for (std::uint32_t i = 0; i < module->prop_count; ++i) {
+      if (module->handles[i].load(std::memory_order_acquire) != nullptr) {
+        continue;
+      }
+      const prop_info* pi =
+          resolve ? __system_property_find(module->prop_names[i]) : nullptr;
+      if (pi == nullptr) {
+        ++stats.unresolved;
+        continue;
+      }
+      module->handles[i].store(pi, std::memory_order_release);
+      ++stats.resolved;
+    }
+  }
+  return stats;
+}
+
+}  // namespace
+
+void RegisterModule(const ModuleDescriptor* module) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  registry.modules.push_back(module);
+}
+
+void UnregisterModule(const ModuleDescriptor* module) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  registry.modules.erase(
+      std::remove(registry.modules.begin(), registry.modules.end(), module),
+      registry.modules.end());
+}
+
+ModuleRegistryStats ResolveAllModules() {
+  return VisitModules(true);
+}
+
+ModuleRegistryStats GetModuleRegistryStats() {
+  return VisitModules(false);
+}
+
+}  // namespace sysprop
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <sys/system_properties.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace sysprop {
+
+// The handle table of a module generated with --module-registry.
+// saved_lookups is null unless the module is also generated with
+// --instrumented, since counting every read would contend on the hot path.
+struct ModuleDescriptor {
+  const char* name;
+  std::uint32_t prop_count;
+  const char* const* prop_names;
+  std::atomic<const prop_info*>* handles;
+  std::atomic<std::uint64_t>* saved_lookups;
+};
+
+// saved_lookups counts the reads which used a resolved handle instead of
+// looking the property up, in instrumented modules only.
+struct ModuleRegistryStats {
+  std::uint32_t modules;
+  std::uint32_t props;
+  std::uint32_t resolved;
+  std::uint32_t unresolved;
+  std::uint64_t saved_lookups;
+};
+
+// Generated sources register their module from a static constructor, and
+// unregister it when they're unloaded. The registry lives in this library, so
+// it covers every binary and shared library of the process which links it.
+void RegisterModule(const ModuleDescriptor* module);
+void UnregisterModule(const ModuleDescriptor* module);
+
+// Registers a module for the lifetime of a static object.
+class ModuleRegistration {
+ public:
+  explicit ModuleRegistration(const ModuleDescriptor* module)
+      : module_(module) {
+    RegisterModule(module_);
+  }
+  ~ModuleRegistration() { UnregisterModule(module_); }
+
+  ModuleRegistration(const ModuleRegistration&) = delete;
+  ModuleRegistration& operator=(const ModuleRegistration&) = delete;
+
+ private:
+  const ModuleDescriptor* module_;
+};
+
+// Resolves the handles of all registered modules in one pass. Properties which
+// don't exist yet are looked up again when they are read. Modules whose static
+// constructors haven't run yet, e.g. when this is called from another static
+// constructor, aren't resolved.
+ModuleRegistryStats ResolveAllModules();
+
+ModuleRegistryStats GetModuleRegistryStats();
+
+}  // namespace sysprop
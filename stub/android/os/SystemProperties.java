@@ -23,6 +23,16 @@ public class SystemProperties {
     }
     public static void set(String key, String val) {
     }
+    public static Handle find(String name) {
+        return null;
+    }
+    public static final class Handle {
+        public String get() {
+            return null;
+        }
+        private Handle() {
+        }
+    }
     private SystemProperties() {
     }
 }
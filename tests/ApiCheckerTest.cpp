@@ -69,6 +69,21 @@ props {
         access: Readonly
         prop_name: "ro.prop4"
     }
+    prop {
+        api_name: "prop5"
+        type: Struct
+        scope: Public
+        access: ReadWrite
+        prop_name: "prop5"
+        struct_fields {
+            name: "width"
+            type: Integer
+        }
+        struct_fields {
+            name: "name"
+            type: String
+        }
+    }
 }
 )";
 
@@ -106,6 +121,25 @@ props {
         prop_name: "ro.prop4"
         deprecated: true
     }
+    prop {
+        api_name: "prop5"
+        type: Struct
+        scope: Public
+        access: ReadWrite
+        prop_name: "prop5"
+        struct_fields {
+            name: "width"
+            type: Integer
+        }
+        struct_fields {
+            name: "name"
+            type: String
+        }
+        struct_fields {
+            name: "dpi"
+            type: Double
+        }
+    }
 
 }
 )";
@@ -137,6 +171,21 @@ props {
         access: ReadWrite
         prop_name: "prop4"
     }
+    prop {
+        api_name: "prop5"
+        type: Struct
+        scope: Public
+        access: ReadWrite
+        prop_name: "prop5"
+        struct_fields {
+            name: "width"
+            type: Long
+        }
+        struct_fields {
+            name: "name"
+            type: String
+        }
+    }
 }
 )";
 
@@ -180,5 +229,6 @@ TEST(SyspropTest, ApiCheckerTest) {
             "Integer-as-bool of prop prop3 has been changed\n"
             "Type of prop prop4 has been changed\n"
             "Scope of prop prop4 has become more restrictive\n"
-            "Underlying property of prop prop4 has been changed\n");
+            "Underlying property of prop prop4 has been changed\n"
+            "Struct fields of prop prop5 has been changed\n");
 }
@@ -15,7 +15,10 @@
  */
 
 #include <unistd.h>
+#include <initializer_list>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/scopeguard.h>
@@ -98,6 +101,37 @@ prop {
     access: ReadWrite
     deprecated: true
 }
+prop {
+    api_name: "test_struct"
+    type: Struct
+    scope: Public
+    access: ReadWrite
+    struct_fields {
+        name: "width"
+        type: Integer
+    }
+    struct_fields {
+        name: "label"
+        type: String
+    }
+    struct_fields {
+        name: "mode"
+        type: Enum
+        enum_values: "on|off"
+    }
+}
+prop {
+    api_name: "test_string_map"
+    type: StringMap
+    scope: Public
+    access: ReadWrite
+}
+prop {
+    api_name: "test_int_map"
+    type: IntegerMap
+    scope: Internal
+    access: Readonly
+}
 )";
 
 constexpr const char* kExpectedHeaderOutput =
@@ -105,11 +139,160 @@ constexpr const char* kExpectedHeaderOutput =
 
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <initializer_list>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include <sys/system_properties.h>
+
+#ifndef SYSPROP_FLAT_MAP_DEFINED
+#define SYSPROP_FLAT_MAP_DEFINED
+
+namespace sysprop {
+
+template <typename T>
+class FlatMap {
+  public:
+    std::size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+
+    std::string_view key(std::size_t index) const {
+        const Entry& entry = entries_[index];
+        return std::string_view(keys_).substr(entry.key_offset, entry.key_size);
+    }
+
+    const std::optional<T>& value(std::size_t index) const { return entries_[index].value; }
+
+    const std::optional<T>* find(std::string_view key) const {
+        std::size_t index = LowerBound(key);
+        if (index == entries_.size() || this->key(index) != key) return nullptr;
+        return &entries_[index].value;
+    }
+
+    bool contains(std::string_view key) const { return find(key) != nullptr; }
+
+    void insert(std::string_view key, std::optional<T> value) {
+        std::size_t index = LowerBound(key);
+        if (index < entries_.size() && this->key(index) == key) {
+            entries_[index].value = std::move(value);
+            return;
+        }
+        Entry entry{keys_.size(), key.size(), std::move(value)};
+        keys_.append(key);
+        entries_.insert(entries_.begin() + index, std::move(entry));
+    }
+
+  private:
+    struct Entry {
+        std::size_t key_offset;
+        std::size_t key_size;
+        std::optional<T> value;
+    };
+
+    std::size_t LowerBound(std::string_view key) const {
+        // Values written by FormatValue are sorted, so appending is the common case.
+        if (entries_.empty() || this->key(entries_.size() - 1) < key) return entries_.size();
+        std::size_t lo = 0;
+        std::size_t hi = entries_.size();
+        while (lo < hi) {
+            std::size_t mid = lo + (hi - lo) / 2;
+            if (this->key(mid) < key) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    std::string keys_;
+    std::vector<Entry> entries_;
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_FLAT_MAP_DEFINED
+
+#ifndef SYSPROP_ENUM_FLAGS_DEFINED
+#define SYSPROP_ENUM_FLAGS_DEFINED
+
+namespace sysprop {
+
+template <typename E>
+class EnumFlags {
+  public:
+    constexpr EnumFlags() = default;
+    constexpr explicit EnumFlags(std::uint64_t bits) : bits_(bits) {}
+    constexpr EnumFlags(std::initializer_list<E> values) {
+        for (E value : values) set(value);
+    }
+
+    constexpr bool test(E value) const { return (bits_ & Bit(value)) != 0; }
+    constexpr bool any() const { return bits_ != 0; }
+    constexpr bool none() const { return bits_ == 0; }
+    constexpr std::uint64_t bits() const { return bits_; }
+
+    constexpr EnumFlags& set(E value, bool on = true) {
+        bits_ = on ? (bits_ | Bit(value)) : (bits_ & ~Bit(value));
+        return *this;
+    }
+
+    constexpr EnumFlags& reset(E value) { return set(value, false); }
+
+    constexpr bool operator==(const EnumFlags& other) const { return bits_ == other.bits_; }
+    constexpr bool operator!=(const EnumFlags& other) const { return bits_ != other.bits_; }
+
+  private:
+    static constexpr std::uint64_t Bit(E value) {
+        return std::uint64_t{1} << static_cast<std::uint32_t>(value);
+    }
+
+    std::uint64_t bits_ = 0;
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_ENUM_FLAGS_DEFINED
+
+#ifndef SYSPROP_INTEGER_STRING_DEFINED
+#define SYSPROP_INTEGER_STRING_DEFINED
+
+namespace sysprop {
+
+template <std::int64_t kValue>
+struct IntegerString {
+    static constexpr std::size_t Size() {
+        std::size_t size = kValue <= 0 ? 1 : 0;
+        for (std::int64_t v = kValue; v != 0; v /= 10) ++size;
+        return size;
+    }
+
+    static constexpr std::array<char, Size() + 1> Format() {
+        std::array<char, Size() + 1> ret{};
+        std::int64_t v = kValue;
+        std::size_t i = Size();
+        do {
+            int digit = static_cast<int>(v % 10);
+            ret[--i] = static_cast<char>('0' + (digit < 0 ? -digit : digit));
+            v /= 10;
+        } while (v != 0);
+        if (kValue < 0) ret[0] = '-';
+        return ret;
+    }
+
+    static constexpr std::array<char, Size() + 1> value = Format();
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_INTEGER_STRING_DEFINED
+
 namespace android::sysprop::PlatformProperties {
 
 std::optional<double> test_double();
@@ -117,6 +300,10 @@ bool test_double(const std::optional<double>& value);
 
 std::optional<std::int32_t> test_int();
 bool test_int(const std::optional<std::int32_t>& value);
+template <std::int32_t kValue>
+inline bool test_int() {
+    return __system_property_set("android.test_int", ::sysprop::IntegerString<kValue>::value.data()) == 0;
+}
 
 std::optional<std::string> test_string();
 bool test_string(const std::optional<std::string>& value);
@@ -133,12 +320,26 @@ enum class test_enum_values {
 
 std::optional<test_enum_values> test_enum();
 bool test_enum(const std::optional<test_enum_values>& value);
+template <test_enum_values kValue>
+inline bool test_enum() {
+    constexpr const char* kValues[] = {"a", "b", "c", "D", "e", "f", "G"};
+    static_assert(static_cast<std::size_t>(kValue) < sizeof(kValues) / sizeof(kValues[0]), "Invalid value for property android.test.enum");
+    return __system_property_set("android.test.enum", kValues[static_cast<std::size_t>(kValue)]) == 0;
+}
 
 std::optional<bool> test_BOOLeaN();
 bool test_BOOLeaN(const std::optional<bool>& value);
+template <bool kValue>
+inline bool test_BOOLeaN() {
+    return __system_property_set("ro.android.test.b", kValue ? "true" : "false") == 0;
+}
 
 std::optional<std::int64_t> android_os_test_long();
 bool android_os_test_long(const std::optional<std::int64_t>& value);
+template <std::int64_t kValue>
+inline bool android_os_test_long() {
+    return __system_property_set("android_os_test-long", ::sysprop::IntegerString<kValue>::value.data()) == 0;
+}
 
 std::vector<std::optional<double>> test_double_list();
 bool test_double_list(const std::vector<std::optional<double>>& value);
@@ -157,6 +358,27 @@ enum class el_values {
 
 [[deprecated]] std::vector<std::optional<el_values>> el();
 [[deprecated]] bool el(const std::vector<std::optional<el_values>>& value);
+[[deprecated]] ::sysprop::EnumFlags<el_values> el_flags();
+[[deprecated]] bool el_flags(const ::sysprop::EnumFlags<el_values>& value);
+
+struct test_struct_values {
+    enum class mode_values {
+        ON,
+        OFF,
+    };
+
+    std::optional<std::int32_t> width;
+    std::optional<std::string> label;
+    std::optional<mode_values> mode;
+};
+
+std::optional<test_struct_values> test_struct();
+bool test_struct(const std::optional<test_struct_values>& value);
+
+::sysprop::FlatMap<std::string> test_string_map();
+bool test_string_map(const ::sysprop::FlatMap<std::string>& value);
+
+::sysprop::FlatMap<std::int32_t> test_int_map();
 
 }  // namespace android::sysprop::PlatformProperties
 )";
@@ -166,24 +388,143 @@ constexpr const char* kExpectedPublicHeaderOutput =
 
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include <sys/system_properties.h>
+
+#ifndef SYSPROP_FLAT_MAP_DEFINED
+#define SYSPROP_FLAT_MAP_DEFINED
+
+namespace sysprop {
+
+template <typename T>
+class FlatMap {
+  public:
+    std::size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+
+    std::string_view key(std::size_t index) const {
+        const Entry& entry = entries_[index];
+        return std::string_view(keys_).substr(entry.key_offset, entry.key_size);
+    }
+
+    const std::optional<T>& value(std::size_t index) const { return entries_[index].value; }
+
+    const std::optional<T>* find(std::string_view key) const {
+        std::size_t index = LowerBound(key);
+        if (index == entries_.size() || this->key(index) != key) return nullptr;
+        return &entries_[index].value;
+    }
+
+    bool contains(std::string_view key) const { return find(key) != nullptr; }
+
+    void insert(std::string_view key, std::optional<T> value) {
+        std::size_t index = LowerBound(key);
+        if (index < entries_.size() && this->key(index) == key) {
+            entries_[index].value = std::move(value);
+            return;
+        }
+        Entry entry{keys_.size(), key.size(), std::move(value)};
+        keys_.append(key);
+        entries_.insert(entries_.begin() + index, std::move(entry));
+    }
+
+  private:
+    struct Entry {
+        std::size_t key_offset;
+        std::size_t key_size;
+        std::optional<T> value;
+    };
+
+    std::size_t LowerBound(std::string_view key) const {
+        // Values written by FormatValue are sorted, so appending is the common case.
+        if (entries_.empty() || this->key(entries_.size() - 1) < key) return entries_.size();
+        std::size_t lo = 0;
+        std::size_t hi = entries_.size();
+        while (lo < hi) {
+            std::size_t mid = lo + (hi - lo) / 2;
+            if (this->key(mid) < key) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    std::string keys_;
+    std::vector<Entry> entries_;
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_FLAT_MAP_DEFINED
+
+#ifndef SYSPROP_INTEGER_STRING_DEFINED
+#define SYSPROP_INTEGER_STRING_DEFINED
+
+namespace sysprop {
+
+template <std::int64_t kValue>
+struct IntegerString {
+    static constexpr std::size_t Size() {
+        std::size_t size = kValue <= 0 ? 1 : 0;
+        for (std::int64_t v = kValue; v != 0; v /= 10) ++size;
+        return size;
+    }
+
+    static constexpr std::array<char, Size() + 1> Format() {
+        std::array<char, Size() + 1> ret{};
+        std::int64_t v = kValue;
+        std::size_t i = Size();
+        do {
+            int digit = static_cast<int>(v % 10);
+            ret[--i] = static_cast<char>('0' + (digit < 0 ? -digit : digit));
+            v /= 10;
+        } while (v != 0);
+        if (kValue < 0) ret[0] = '-';
+        return ret;
+    }
+
+    static constexpr std::array<char, Size() + 1> value = Format();
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_INTEGER_STRING_DEFINED
+
 namespace android::sysprop::PlatformProperties {
 
 std::optional<std::int32_t> test_int();
 bool test_int(const std::optional<std::int32_t>& value);
+template <std::int32_t kValue>
+inline bool test_int() {
+    return __system_property_set("android.test_int", ::sysprop::IntegerString<kValue>::value.data()) == 0;
+}
 
 std::optional<std::string> test_string();
 bool test_string(const std::optional<std::string>& value);
 
 std::optional<bool> test_BOOLeaN();
 bool test_BOOLeaN(const std::optional<bool>& value);
+template <bool kValue>
+inline bool test_BOOLeaN() {
+    return __system_property_set("ro.android.test.b", kValue ? "true" : "false") == 0;
+}
 
 std::optional<std::int64_t> android_os_test_long();
 bool android_os_test_long(const std::optional<std::int64_t>& value);
+template <std::int64_t kValue>
+inline bool android_os_test_long() {
+    return __system_property_set("android_os_test-long", ::sysprop::IntegerString<kValue>::value.data()) == 0;
+}
 
 std::vector<std::optional<std::int32_t>> test_list_int();
 bool test_list_int(const std::vector<std::optional<std::int32_t>>& value);
@@ -191,6 +532,23 @@ bool test_list_int(const std::vector<std::optional<std::int32_t>>& value);
 [[deprecated]] std::vector<std::optional<std::string>> test_strlist();
 [[deprecated]] bool test_strlist(const std::vector<std::optional<std::string>>& value);
 
+struct test_struct_values {
+    enum class mode_values {
+        ON,
+        OFF,
+    };
+
+    std::optional<std::int32_t> width;
+    std::optional<std::string> label;
+    std::optional<mode_values> mode;
+};
+
+std::optional<test_struct_values> test_struct();
+bool test_struct(const std::optional<test_struct_values>& value);
+
+::sysprop::FlatMap<std::string> test_string_map();
+bool test_string_map(const ::sysprop::FlatMap<std::string>& value);
+
 }  // namespace android::sysprop::PlatformProperties
 )";
 
@@ -216,8 +574,6 @@ namespace {
 
 using namespace android::sysprop::PlatformProperties;
 
-template <typename T> T DoParse(const char* str);
-
 constexpr const std::pair<const char*, test_enum_values> test_enum_list[] = {
     {"a", test_enum_values::A},
     {"b", test_enum_values::B},
@@ -228,14 +584,14 @@ constexpr const std::pair<const char*, test_enum_values> test_enum_list[] = {
     {"G", test_enum_values::G},
 };
 
-template <>
-std::optional<test_enum_values> DoParse(const char* str) {
+void DoParse(const char* str, std::optional<test_enum_values>* out) {
     for (auto [name, val] : test_enum_list) {
         if (strcmp(str, name) == 0) {
-            return val;
+            *out = val;
+            return;
         }
     }
-    return std::nullopt;
+    *out = std::nullopt;
 }
 
 std::string FormatValue(std::optional<test_enum_values> value) {
@@ -255,14 +611,14 @@ constexpr const std::pair<const char*, el_values> el_list[] = {
     {"lue", el_values::LUE},
 };
 
-template <>
-std::optional<el_values> DoParse(const char* str) {
+void DoParse(const char* str, std::optional<el_values>* out) {
     for (auto [name, val] : el_list) {
         if (strcmp(str, name) == 0) {
-            return val;
+            *out = val;
+            return;
         }
     }
-    return std::nullopt;
+    *out = std::nullopt;
 }
 
 std::string FormatValue(std::optional<el_values> value) {
@@ -276,57 +632,131 @@ std::string FormatValue(std::optional<el_values> value) {
     __builtin_unreachable();
 }
 
-template <typename T> constexpr bool is_vector = false;
+void DoParse(const char* str, ::sysprop::EnumFlags<el_values>* out) {
+    while (*str != '\0') {
+        const char* end = std::strchr(str, ',');
+        std::size_t size = end != nullptr ? end - str : std::strlen(str);
+        for (auto [name, val] : el_list) {
+            if (std::strncmp(str, name, size) == 0 && name[size] == '\0') {
+                out->set(val);
+                break;
+            }
+        }
+        if (end == nullptr) break;
+        str = end + 1;
+    }
+}
+
+std::string FormatValue(const ::sysprop::EnumFlags<el_values>& value) {
+    std::string ret;
+    for (auto [name, val] : el_list) {
+        if (!value.test(val)) continue;
+        if (!ret.empty()) ret += ',';
+        ret += name;
+    }
+    return ret;
+}
+
+constexpr const std::pair<const char*, test_struct_values::mode_values> test_struct_mode_list[] = {
+    {"on", test_struct_values::mode_values::ON},
+    {"off", test_struct_values::mode_values::OFF},
+};
+
+void DoParse(const char* str, std::optional<test_struct_values::mode_values>* out) {
+    for (auto [name, val] : test_struct_mode_list) {
+        if (strcmp(str, name) == 0) {
+            *out = val;
+            return;
+        }
+    }
+    *out = std::nullopt;
+}
 
-template <typename T> constexpr bool is_vector<std::vector<T>> = true;
+std::string FormatValue(std::optional<test_struct_values::mode_values> value) {
+    if (!value) return "";
+    for (auto [name, val] : test_struct_mode_list) {
+        if (val == *value) {
+            return name;
+        }
+    }
+    LOG_ALWAYS_FATAL("Invalid value %d for property test_struct", static_cast<std::int32_t>(*value));
+    __builtin_unreachable();
+}
 
-template <> [[maybe_unused]] std::optional<bool> DoParse(const char* str) {
+void DoParse(const char* str, std::optional<bool>* out) {
     static constexpr const char* kYes[] = {"1", "true"};
     static constexpr const char* kNo[] = {"0", "false"};
 
     for (const char* yes : kYes) {
-        if (strcasecmp(yes, str) == 0) return std::make_optional(true);
+        if (strcasecmp(yes, str) == 0) {
+            *out = true;
+            return;
+        }
     }
 
     for (const char* no : kNo) {
-        if (strcasecmp(no, str) == 0) return std::make_optional(false);
+        if (strcasecmp(no, str) == 0) {
+            *out = false;
+            return;
+        }
     }
 
-    return std::nullopt;
+    *out = std::nullopt;
+}
+
+std::string FormatValue(const std::optional<bool>& value) {
+    return value ? (*value ? "true" : "false") : "";
 }
 
-template <> [[maybe_unused]] std::optional<std::int32_t> DoParse(const char* str) {
+void DoParse(const char* str, std::optional<std::int32_t>* out) {
     std::int32_t ret;
-    return android::base::ParseInt(str, &ret) ? std::make_optional(ret) : std::nullopt;
+    *out = android::base::ParseInt(str, &ret) ? std::make_optional(ret) : std::nullopt;
+}
+
+std::string FormatValue(const std::optional<std::int32_t>& value) {
+    return value ? std::to_string(*value) : "";
 }
 
-template <> [[maybe_unused]] std::optional<std::int64_t> DoParse(const char* str) {
+void DoParse(const char* str, std::optional<std::int64_t>* out) {
     std::int64_t ret;
-    return android::base::ParseInt(str, &ret) ? std::make_optional(ret) : std::nullopt;
+    *out = android::base::ParseInt(str, &ret) ? std::make_optional(ret) : std::nullopt;
+}
+
+std::string FormatValue(const std::optional<std::int64_t>& value) {
+    return value ? std::to_string(*value) : "";
 }
 
-template <> [[maybe_unused]] std::optional<double> DoParse(const char* str) {
+void DoParse(const char* str, std::optional<double>* out) {
     int old_errno = errno;
     errno = 0;
     char* end;
     double ret = std::strtod(str, &end);
     if (errno != 0) {
-        return std::nullopt;
+        *out = std::nullopt;
+        return;
     }
     if (str == end || *end != '\0') {
         errno = EINVAL;
-        return std::nullopt;
+        *out = std::nullopt;
+        return;
     }
     errno = old_errno;
-    return std::make_optional(ret);
+    *out = ret;
 }
 
-template <> [[maybe_unused]] std::optional<std::string> DoParse(const char* str) {
-    return *str == '\0' ? std::nullopt : std::make_optional(str);
+std::string FormatValue(const std::optional<double>& value) {
+    if (!value) return "";
+    char buf[1024];
+    std::sprintf(buf, "%.*g", std::numeric_limits<double>::max_digits10, *value);
+    return buf;
 }
 
-template <typename Vec> [[maybe_unused]] Vec DoParseList(const char* str) {
-    Vec ret;
+void DoParse(const char* str, std::optional<std::string>* out) {
+    *out = *str == '\0' ? std::nullopt : std::make_optional(str);
+}
+
+std::vector<std::string> SplitListValue(const char* str) {
+    std::vector<std::string> ret;
     if (*str == '\0') return ret;
     const char* p = str;
     for (;;) {
@@ -337,147 +767,403 @@ template <typename Vec> [[maybe_unused]] Vec DoParseList(const char* str) {
             if (*r == '\0') break;
             value += *r++;
         }
-        ret.emplace_back(DoParse<typename Vec::value_type>(value.c_str()));
+        ret.emplace_back(std::move(value));
         if (*r == '\0') break;
         p = r + 1;
     }
     return ret;
 }
 
-template <typename T> inline T TryParse(const char* str) {
-    if constexpr(is_vector<T>) {
-        return DoParseList<T>(str);
-    } else {
-        return DoParse<T>(str);
+void DoParse(const char* str, std::vector<std::optional<double>>* out) {
+    for (const std::string& element : SplitListValue(str)) {
+        DoParse(element.c_str(), &out->emplace_back());
     }
 }
 
-[[maybe_unused]] std::string FormatValue(const std::optional<std::int32_t>& value) {
-    return value ? std::to_string(*value) : "";
-}
-
-[[maybe_unused]] std::string FormatValue(const std::optional<std::int64_t>& value) {
-    return value ? std::to_string(*value) : "";
+void DoParse(const char* str, std::vector<std::optional<std::int32_t>>* out) {
+    for (const std::string& element : SplitListValue(str)) {
+        DoParse(element.c_str(), &out->emplace_back());
+    }
 }
 
-[[maybe_unused]] std::string FormatValue(const std::optional<double>& value) {
-    if (!value) return "";
-    char buf[1024];
-    std::sprintf(buf, "%.*g", std::numeric_limits<double>::max_digits10, *value);
-    return buf;
+void DoParse(const char* str, std::vector<std::optional<std::string>>* out) {
+    for (const std::string& element : SplitListValue(str)) {
+        DoParse(element.c_str(), &out->emplace_back());
+    }
 }
 
-[[maybe_unused]] std::string FormatValue(const std::optional<bool>& value) {
-    return value ? (*value ? "true" : "false") : "";
+void DoParse(const char* str, std::vector<std::optional<el_values>>* out) {
+    for (const std::string& element : SplitListValue(str)) {
+        DoParse(element.c_str(), &out->emplace_back());
+    }
 }
 
-template <typename T>
-[[maybe_unused]] std::string FormatValue(const std::vector<T>& value) {
-    if (value.empty()) return "";
-
+std::string FormatValue(const std::vector<std::optional<double>>& value) {
     std::string ret;
     bool first = true;
 
     for (auto&& element : value) {
         if (!first) ret += ',';
         else first = false;
-        if constexpr(std::is_same_v<T, std::optional<std::string>>) {
-            if (element) {
-                for (char c : *element) {
-                    if (c == '\\' || c == ',') ret += '\\';
-                    ret += c;
-                }
-            }
-        } else {
-            ret += FormatValue(element);
-        }
+        ret += FormatValue(element);
     }
 
     return ret;
 }
 
-template <typename T>
-T GetProp(const char* key) {
-    T ret;
-    auto pi = __system_property_find(key);
-    if (pi != nullptr) {
-        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
-            *static_cast<T*>(cookie) = TryParse<T>(value);
-        }, &ret);
+std::string FormatValue(const std::vector<std::optional<std::int32_t>>& value) {
+    std::string ret;
+    bool first = true;
+
+    for (auto&& element : value) {
+        if (!first) ret += ',';
+        else first = false;
+        ret += FormatValue(element);
     }
+
     return ret;
 }
 
-}  // namespace
+std::string FormatValue(const std::vector<std::optional<std::string>>& value) {
+    std::string ret;
+    bool first = true;
 
-namespace android::sysprop::PlatformProperties {
+    for (auto&& element : value) {
+        if (!first) ret += ',';
+        else first = false;
+        if (element) {
+            for (char c : *element) {
+                if (c == '\\' || c == ',') ret += '\\';
+                ret += c;
+            }
+        }
+    }
 
-std::optional<double> test_double() {
-    return GetProp<std::optional<double>>("android.test_double");
+    return ret;
 }
 
-bool test_double(const std::optional<double>& value) {
-    return __system_property_set("android.test_double", FormatValue(value).c_str()) == 0;
-}
+std::string FormatValue(const std::vector<std::optional<el_values>>& value) {
+    std::string ret;
+    bool first = true;
 
-std::optional<std::int32_t> test_int() {
-    return GetProp<std::optional<std::int32_t>>("android.test_int");
-}
+    for (auto&& element : value) {
+        if (!first) ret += ',';
+        else first = false;
+        ret += FormatValue(element);
+    }
 
-bool test_int(const std::optional<std::int32_t>& value) {
-    return __system_property_set("android.test_int", FormatValue(value).c_str()) == 0;
+    return ret;
 }
 
-std::optional<std::string> test_string() {
-    return GetProp<std::optional<std::string>>("android.test.string");
+void DoParse(const char* str, ::sysprop::FlatMap<std::string>* out) {
+    std::string key;
+    std::string value;
+    const char* p = str;
+    while (*p != '\0') {
+        key.clear();
+        value.clear();
+        std::string* token = &key;
+        for (; *p != '\0' && *p != ','; ++p) {
+            if (*p == '=' && token == &key) {
+                token = &value;
+                continue;
+            }
+            if (*p == '\\' && *(p + 1) != '\0') ++p;
+            *token += *p;
+        }
+        if (*p == ',') ++p;
+        std::optional<std::string> parsed;
+        DoParse(value.c_str(), &parsed);
+        out->insert(key, std::move(parsed));
+    }
 }
 
-bool test_string(const std::optional<std::string>& value) {
-    return __system_property_set("android.test.string", value ? value->c_str() : "") == 0;
+void DoParse(const char* str, ::sysprop::FlatMap<std::int32_t>* out) {
+    std::string key;
+    std::string value;
+    const char* p = str;
+    while (*p != '\0') {
+        key.clear();
+        value.clear();
+        std::string* token = &key;
+        for (; *p != '\0' && *p != ','; ++p) {
+            if (*p == '=' && token == &key) {
+                token = &value;
+                continue;
+            }
+            if (*p == '\\' && *(p + 1) != '\0') ++p;
+            *token += *p;
+        }
+        if (*p == ',') ++p;
+        std::optional<std::int32_t> parsed;
+        DoParse(value.c_str(), &parsed);
+        out->insert(key, std::move(parsed));
+    }
 }
 
-std::optional<test_enum_values> test_enum() {
-    return GetProp<std::optional<test_enum_values>>("android.test.enum");
+void AppendMapToken(std::string* ret, std::string_view token) {
+    for (char c : token) {
+        if (c == '\\' || c == ',' || c == '=') *ret += '\\';
+        *ret += c;
+    }
 }
 
-bool test_enum(const std::optional<test_enum_values>& value) {
-    return __system_property_set("android.test.enum", FormatValue(value).c_str()) == 0;
-}
+std::string FormatValue(const ::sysprop::FlatMap<std::string>& value) {
+    std::string ret;
 
-std::optional<bool> test_BOOLeaN() {
-    return GetProp<std::optional<bool>>("ro.android.test.b");
-}
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        if (i > 0) ret += ',';
+        AppendMapToken(&ret, value.key(i));
+        ret += '=';
+        if (value.value(i)) AppendMapToken(&ret, *value.value(i));
+    }
 
-bool test_BOOLeaN(const std::optional<bool>& value) {
-    return __system_property_set("ro.android.test.b", FormatValue(value).c_str()) == 0;
+    return ret;
 }
 
-std::optional<std::int64_t> android_os_test_long() {
-    return GetProp<std::optional<std::int64_t>>("android_os_test-long");
+void DoParse(const char* str, std::optional<test_struct_values>* out) {
+    if (*str == '\0') {
+        *out = std::nullopt;
+        return;
+    }
+    std::vector<std::string> fields = SplitListValue(str);
+    fields.resize(3);
+    test_struct_values& value = out->emplace();
+    DoParse(fields[0].c_str(), &value.width);
+    DoParse(fields[1].c_str(), &value.label);
+    DoParse(fields[2].c_str(), &value.mode);
 }
 
-bool android_os_test_long(const std::optional<std::int64_t>& value) {
-    return __system_property_set("android_os_test-long", FormatValue(value).c_str()) == 0;
+std::string FormatValue(const std::optional<test_struct_values>& value) {
+    if (!value) return "";
+    std::string ret;
+    ret += FormatValue(value->width);
+    ret += ',';
+    if (value->label) {
+        for (char c : *value->label) {
+            if (c == '\\' || c == ',') ret += '\\';
+            ret += c;
+        }
+    }
+    ret += ',';
+    ret += FormatValue(value->mode);
+    return ret;
 }
 
-std::vector<std::optional<double>> test_double_list() {
-    return GetProp<std::vector<std::optional<double>>>("test_double_list");
+void GetProp(const char* key, std::optional<double>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<double>*>(cookie));
+        }, value);
+    }
 }
 
-bool test_double_list(const std::vector<std::optional<double>>& value) {
-    return __system_property_set("test_double_list", FormatValue(value).c_str()) == 0;
+void GetProp(const char* key, std::optional<std::int32_t>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<std::int32_t>*>(cookie));
+        }, value);
+    }
 }
 
-std::vector<std::optional<std::int32_t>> test_list_int() {
-    return GetProp<std::vector<std::optional<std::int32_t>>>("test_list_int");
-}
+void GetProp(const char* key, std::optional<std::string>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<std::string>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, std::optional<test_enum_values>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<test_enum_values>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, std::optional<bool>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<bool>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, std::optional<std::int64_t>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<std::int64_t>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, std::vector<std::optional<double>>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::vector<std::optional<double>>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, std::vector<std::optional<std::int32_t>>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::vector<std::optional<std::int32_t>>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, std::vector<std::optional<std::string>>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::vector<std::optional<std::string>>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, std::vector<std::optional<el_values>>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::vector<std::optional<el_values>>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, ::sysprop::EnumFlags<el_values>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<::sysprop::EnumFlags<el_values>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, std::optional<test_struct_values>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<test_struct_values>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, ::sysprop::FlatMap<std::string>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<::sysprop::FlatMap<std::string>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, ::sysprop::FlatMap<std::int32_t>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<::sysprop::FlatMap<std::int32_t>*>(cookie));
+        }, value);
+    }
+}
+
+}  // namespace
+
+namespace android::sysprop::PlatformProperties {
+
+std::optional<double> test_double() {
+    std::optional<double> ret;
+    GetProp("android.test_double", &ret);
+    return ret;
+}
+
+bool test_double(const std::optional<double>& value) {
+    return __system_property_set("android.test_double", FormatValue(value).c_str()) == 0;
+}
+
+std::optional<std::int32_t> test_int() {
+    std::optional<std::int32_t> ret;
+    GetProp("android.test_int", &ret);
+    return ret;
+}
+
+bool test_int(const std::optional<std::int32_t>& value) {
+    return __system_property_set("android.test_int", FormatValue(value).c_str()) == 0;
+}
+
+std::optional<std::string> test_string() {
+    std::optional<std::string> ret;
+    GetProp("android.test.string", &ret);
+    return ret;
+}
+
+bool test_string(const std::optional<std::string>& value) {
+    return __system_property_set("android.test.string", value ? value->c_str() : "") == 0;
+}
+
+std::optional<test_enum_values> test_enum() {
+    std::optional<test_enum_values> ret;
+    GetProp("android.test.enum", &ret);
+    return ret;
+}
+
+bool test_enum(const std::optional<test_enum_values>& value) {
+    return __system_property_set("android.test.enum", FormatValue(value).c_str()) == 0;
+}
+
+std::optional<bool> test_BOOLeaN() {
+    std::optional<bool> ret;
+    GetProp("ro.android.test.b", &ret);
+    return ret;
+}
+
+bool test_BOOLeaN(const std::optional<bool>& value) {
+    return __system_property_set("ro.android.test.b", FormatValue(value).c_str()) == 0;
+}
+
+std::optional<std::int64_t> android_os_test_long() {
+    std::optional<std::int64_t> ret;
+    GetProp("android_os_test-long", &ret);
+    return ret;
+}
+
+bool android_os_test_long(const std::optional<std::int64_t>& value) {
+    return __system_property_set("android_os_test-long", FormatValue(value).c_str()) == 0;
+}
+
+std::vector<std::optional<double>> test_double_list() {
+    std::vector<std::optional<double>> ret;
+    GetProp("test_double_list", &ret);
+    return ret;
+}
+
+bool test_double_list(const std::vector<std::optional<double>>& value) {
+    return __system_property_set("test_double_list", FormatValue(value).c_str()) == 0;
+}
+
+std::vector<std::optional<std::int32_t>> test_list_int() {
+    std::vector<std::optional<std::int32_t>> ret;
+    GetProp("test_list_int", &ret);
+    return ret;
+}
 
 bool test_list_int(const std::vector<std::optional<std::int32_t>>& value) {
     return __system_property_set("test_list_int", FormatValue(value).c_str()) == 0;
 }
 
 std::vector<std::optional<std::string>> test_strlist() {
-    return GetProp<std::vector<std::optional<std::string>>>("test_strlist");
+    std::vector<std::optional<std::string>> ret;
+    GetProp("test_strlist", &ret);
+    return ret;
 }
 
 bool test_strlist(const std::vector<std::optional<std::string>>& value) {
@@ -485,59 +1171,2247 @@ bool test_strlist(const std::vector<std::optional<std::string>>& value) {
 }
 
 std::vector<std::optional<el_values>> el() {
-    return GetProp<std::vector<std::optional<el_values>>>("el");
+    std::vector<std::optional<el_values>> ret;
+    GetProp("el", &ret);
+    return ret;
 }
 
 bool el(const std::vector<std::optional<el_values>>& value) {
     return __system_property_set("el", FormatValue(value).c_str()) == 0;
 }
 
+::sysprop::EnumFlags<el_values> el_flags() {
+    ::sysprop::EnumFlags<el_values> ret;
+    GetProp("el", &ret);
+    return ret;
+}
+
+bool el_flags(const ::sysprop::EnumFlags<el_values>& value) {
+    return __system_property_set("el", FormatValue(value).c_str()) == 0;
+}
+
+std::optional<test_struct_values> test_struct() {
+    std::optional<test_struct_values> ret;
+    GetProp("test_struct", &ret);
+    return ret;
+}
+
+bool test_struct(const std::optional<test_struct_values>& value) {
+    return __system_property_set("test_struct", FormatValue(value).c_str()) == 0;
+}
+
+::sysprop::FlatMap<std::string> test_string_map() {
+    ::sysprop::FlatMap<std::string> ret;
+    GetProp("test_string_map", &ret);
+    return ret;
+}
+
+bool test_string_map(const ::sysprop::FlatMap<std::string>& value) {
+    return __system_property_set("test_string_map", FormatValue(value).c_str()) == 0;
+}
+
+::sysprop::FlatMap<std::int32_t> test_int_map() {
+    ::sysprop::FlatMap<std::int32_t> ret;
+    GetProp("ro.test_int_map", &ret);
+    return ret;
+}
+
 }  // namespace android::sysprop::PlatformProperties
 )";
 
-}  // namespace
+constexpr const char* kTestTableDrivenSyspropFile =
+    R"(owner: Platform
+module: "android.sysprop.TableProperties"
+prop {
+    api_name: "test_int"
+    type: Integer
+    prop_name: "android.test_int"
+    scope: Public
+    access: ReadWrite
+}
+prop {
+    api_name: "test_enum"
+    type: Enum
+    prop_name: "android.test.enum"
+    enum_values: "a|b|c"
+    scope: Public
+    access: ReadWrite
+}
+prop {
+    api_name: "test_bool"
+    type: Boolean
+    prop_name: "ro.android.test.b"
+    scope: Public
+    access: Writeonce
+    integer_as_bool: true
+}
+prop {
+    api_name: "test_strlist"
+    type: StringList
+    prop_name: "ro.android.test.strlist"
+    scope: Internal
+    access: Readonly
+}prop {
+    api_name: "test_features"
+    type: EnumList
+    prop_name: "android.test.features"
+    enum_values: "x|y|z"
+    scope: Public
+    access: ReadWrite
+}
+)";
 
-using namespace std::string_literals;
+constexpr const char* kExpectedTableDrivenHeaderOutput =
+    R"(// Generated by the sysprop generator. DO NOT EDIT!
 
-TEST(SyspropTest, CppGenTest) {
-  TemporaryDir temp_dir;
+#pragma once
 
-  std::string temp_sysprop_path = temp_dir.path + "/PlatformProperties.sysprop"s;
-  ASSERT_TRUE(
-      android::base::WriteStringToFile(kTestSyspropFile, temp_sysprop_path));
-
-  auto sysprop_deleter = android::base::make_scope_guard(
-      [&] { unlink(temp_sysprop_path.c_str()); });
-
-  ASSERT_RESULT_OK(GenerateCppFiles(temp_sysprop_path, temp_dir.path,
-                                    temp_dir.path + "/public"s, temp_dir.path,
-                                    "properties/PlatformProperties.sysprop.h"));
-
-  std::string header_output_path =
-      temp_dir.path + "/PlatformProperties.sysprop.h"s;
-  std::string public_header_output_path =
-      temp_dir.path + "/public/PlatformProperties.sysprop.h"s;
-  std::string source_output_path =
-      temp_dir.path + "/PlatformProperties.sysprop.cpp"s;
-
-  auto generated_file_deleter = android::base::make_scope_guard([&] {
-    unlink(header_output_path.c_str());
-    unlink(public_header_output_path.c_str());
-    unlink(source_output_path.c_str());
-  });
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifndef SYSPROP_ENUM_FLAGS_DEFINED
+#define SYSPROP_ENUM_FLAGS_DEFINED
+
+namespace sysprop {
+
+template <typename E>
+class EnumFlags {
+  public:
+    constexpr EnumFlags() = default;
+    constexpr explicit EnumFlags(std::uint64_t bits) : bits_(bits) {}
+    constexpr EnumFlags(std::initializer_list<E> values) {
+        for (E value : values) set(value);
+    }
+
+    constexpr bool test(E value) const { return (bits_ & Bit(value)) != 0; }
+    constexpr bool any() const { return bits_ != 0; }
+    constexpr bool none() const { return bits_ == 0; }
+    constexpr std::uint64_t bits() const { return bits_; }
+
+    constexpr EnumFlags& set(E value, bool on = true) {
+        bits_ = on ? (bits_ | Bit(value)) : (bits_ & ~Bit(value));
+        return *this;
+    }
+
+    constexpr EnumFlags& reset(E value) { return set(value, false); }
+
+    constexpr bool operator==(const EnumFlags& other) const { return bits_ == other.bits_; }
+    constexpr bool operator!=(const EnumFlags& other) const { return bits_ != other.bits_; }
+
+  private:
+    static constexpr std::uint64_t Bit(E value) {
+        return std::uint64_t{1} << static_cast<std::uint32_t>(value);
+    }
+
+    std::uint64_t bits_ = 0;
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_ENUM_FLAGS_DEFINED
+
+#ifndef SYSPROP_INTEGER_STRING_DEFINED
+#define SYSPROP_INTEGER_STRING_DEFINED
+
+namespace sysprop {
+
+template <std::int64_t kValue>
+struct IntegerString {
+    static constexpr std::size_t Size() {
+        std::size_t size = kValue <= 0 ? 1 : 0;
+        for (std::int64_t v = kValue; v != 0; v /= 10) ++size;
+        return size;
+    }
+
+    static constexpr std::array<char, Size() + 1> Format() {
+        std::array<char, Size() + 1> ret{};
+        std::int64_t v = kValue;
+        std::size_t i = Size();
+        do {
+            int digit = static_cast<int>(v % 10);
+            ret[--i] = static_cast<char>('0' + (digit < 0 ? -digit : digit));
+            v /= 10;
+        } while (v != 0);
+        if (kValue < 0) ret[0] = '-';
+        return ret;
+    }
+
+    static constexpr std::array<char, Size() + 1> value = Format();
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_INTEGER_STRING_DEFINED
+
+namespace android::sysprop::TableProperties {
+
+// Accessors take the index of the property in the source, with the hash of its
+// name in the upper 32 bits. The source aborts on keys which don't match, so
+// this header and all code including it must be rebuilt whenever the sysprop
+// file changes.
+namespace internal {
+
+std::optional<std::int32_t> GetInteger(std::uint64_t key);
+bool SetInteger(std::uint64_t key, const std::optional<std::int32_t>& value);
+std::optional<std::int32_t> GetEnum(std::uint64_t key);
+bool SetEnum(std::uint64_t key, const std::optional<std::int32_t>& value);
+std::optional<bool> GetBoolean(std::uint64_t key);
+bool SetBoolean(std::uint64_t key, const std::optional<bool>& value);
+std::vector<std::optional<std::string>> GetStringList(std::uint64_t key);
+std::vector<std::optional<std::int32_t>> GetEnumList(std::uint64_t key);
+bool SetEnumList(std::uint64_t key, const std::vector<std::optional<std::int32_t>>& value);
+bool SetRawValue(std::uint64_t key, const char* value);
+std::uint64_t GetEnumFlags(std::uint64_t key);
+bool SetEnumFlags(std::uint64_t key, std::uint64_t value);
+
+template <typename E>
+inline std::optional<E> ToEnum(const std::optional<std::int32_t>& value) {
+    return value ? std::make_optional(static_cast<E>(*value)) : std::nullopt;
+}
+
+template <typename E>
+inline std::vector<std::optional<E>> ToEnum(const std::vector<std::optional<std::int32_t>>& value) {
+    std::vector<std::optional<E>> ret;
+    ret.reserve(value.size());
+    for (auto&& element : value) ret.push_back(ToEnum<E>(element));
+    return ret;
+}
+
+template <typename E>
+inline std::optional<std::int32_t> FromEnum(const std::optional<E>& value) {
+    return value ? std::make_optional(static_cast<std::int32_t>(*value)) : std::nullopt;
+}
+
+template <typename E>
+inline std::vector<std::optional<std::int32_t>> FromEnum(const std::vector<std::optional<E>>& value) {
+    std::vector<std::optional<std::int32_t>> ret;
+    ret.reserve(value.size());
+    for (auto&& element : value) ret.push_back(FromEnum(element));
+    return ret;
+}
+
+}  // namespace internal
+
+inline std::optional<std::int32_t> test_int() {
+    return internal::GetInteger(0x14b5f8ec00000000ull);
+}
+inline bool test_int(const std::optional<std::int32_t>& value) {
+    return internal::SetInteger(0x14b5f8ec00000000ull, value);
+}
+template <std::int32_t kValue>
+inline bool test_int() {
+    return internal::SetRawValue(0x14b5f8ec00000000ull, ::sysprop::IntegerString<kValue>::value.data());
+}
+
+enum class test_enum_values {
+    A,
+    B,
+    C,
+};
+
+inline std::optional<test_enum_values> test_enum() {
+    return internal::ToEnum<test_enum_values>(internal::GetEnum(0x05980a1d00000001ull));
+}
+inline bool test_enum(const std::optional<test_enum_values>& value) {
+    return internal::SetEnum(0x05980a1d00000001ull, internal::FromEnum(value));
+}
+template <test_enum_values kValue>
+inline bool test_enum() {
+    constexpr const char* kValues[] = {"a", "b", "c"};
+    static_assert(static_cast<std::size_t>(kValue) < sizeof(kValues) / sizeof(kValues[0]), "Invalid value for property android.test.enum");
+    return internal::SetRawValue(0x05980a1d00000001ull, kValues[static_cast<std::size_t>(kValue)]);
+}
+
+inline std::optional<bool> test_bool() {
+    return internal::GetBoolean(0xb6ed6a4300000002ull);
+}
+inline bool test_bool(const std::optional<bool>& value) {
+    return internal::SetBoolean(0xb6ed6a4300000002ull, value);
+}
+template <bool kValue>
+inline bool test_bool() {
+    return internal::SetRawValue(0xb6ed6a4300000002ull, kValue ? "1" : "0");
+}
 
-  std::string header_output;
-  ASSERT_TRUE(android::base::ReadFileToString(header_output_path,
-                                              &header_output, true));
-  EXPECT_EQ(header_output, kExpectedHeaderOutput);
+inline std::vector<std::optional<std::string>> test_strlist() {
+    return internal::GetStringList(0x6334b06600000003ull);
+}
 
-  std::string public_header_output;
-  ASSERT_TRUE(android::base::ReadFileToString(public_header_output_path,
-                                              &public_header_output, true));
-  EXPECT_EQ(public_header_output, kExpectedPublicHeaderOutput);
+enum class test_features_values {
+    X,
+    Y,
+    Z,
+};
 
-  std::string source_output;
-  ASSERT_TRUE(android::base::ReadFileToString(source_output_path,
-                                              &source_output, true));
-  EXPECT_EQ(source_output, kExpectedSourceOutput);
+inline std::vector<std::optional<test_features_values>> test_features() {
+    return internal::ToEnum<test_features_values>(internal::GetEnumList(0xb313ae6700000004ull));
+}
+inline bool test_features(const std::vector<std::optional<test_features_values>>& value) {
+    return internal::SetEnumList(0xb313ae6700000004ull, internal::FromEnum(value));
+}
+inline ::sysprop::EnumFlags<test_features_values> test_features_flags() {
+    return ::sysprop::EnumFlags<test_features_values>(internal::GetEnumFlags(0xb313ae6700000004ull));
+}
+inline bool test_features_flags(const ::sysprop::EnumFlags<test_features_values>& value) {
+    return internal::SetEnumFlags(0xb313ae6700000004ull, value.bits());
+}
+
+}  // namespace android::sysprop::TableProperties
+)";
+
+constexpr const char* kExpectedTableDrivenPublicHeaderOutput =
+    R"(// Generated by the sysprop generator. DO NOT EDIT!
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifndef SYSPROP_ENUM_FLAGS_DEFINED
+#define SYSPROP_ENUM_FLAGS_DEFINED
+
+namespace sysprop {
+
+template <typename E>
+class EnumFlags {
+  public:
+    constexpr EnumFlags() = default;
+    constexpr explicit EnumFlags(std::uint64_t bits) : bits_(bits) {}
+    constexpr EnumFlags(std::initializer_list<E> values) {
+        for (E value : values) set(value);
+    }
+
+    constexpr bool test(E value) const { return (bits_ & Bit(value)) != 0; }
+    constexpr bool any() const { return bits_ != 0; }
+    constexpr bool none() const { return bits_ == 0; }
+    constexpr std::uint64_t bits() const { return bits_; }
+
+    constexpr EnumFlags& set(E value, bool on = true) {
+        bits_ = on ? (bits_ | Bit(value)) : (bits_ & ~Bit(value));
+        return *this;
+    }
+
+    constexpr EnumFlags& reset(E value) { return set(value, false); }
+
+    constexpr bool operator==(const EnumFlags& other) const { return bits_ == other.bits_; }
+    constexpr bool operator!=(const EnumFlags& other) const { return bits_ != other.bits_; }
+
+  private:
+    static constexpr std::uint64_t Bit(E value) {
+        return std::uint64_t{1} << static_cast<std::uint32_t>(value);
+    }
+
+    std::uint64_t bits_ = 0;
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_ENUM_FLAGS_DEFINED
+
+#ifndef SYSPROP_INTEGER_STRING_DEFINED
+#define SYSPROP_INTEGER_STRING_DEFINED
+
+namespace sysprop {
+
+template <std::int64_t kValue>
+struct IntegerString {
+    static constexpr std::size_t Size() {
+        std::size_t size = kValue <= 0 ? 1 : 0;
+        for (std::int64_t v = kValue; v != 0; v /= 10) ++size;
+        return size;
+    }
+
+    static constexpr std::array<char, Size() + 1> Format() {
+        std::array<char, Size() + 1> ret{};
+        std::int64_t v = kValue;
+        std::size_t i = Size();
+        do {
+            int digit = static_cast<int>(v % 10);
+            ret[--i] = static_cast<char>('0' + (digit < 0 ? -digit : digit));
+            v /= 10;
+        } while (v != 0);
+        if (kValue < 0) ret[0] = '-';
+        return ret;
+    }
+
+    static constexpr std::array<char, Size() + 1> value = Format();
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_INTEGER_STRING_DEFINED
+
+namespace android::sysprop::TableProperties {
+
+// Accessors take the index of the property in the source, with the hash of its
+// name in the upper 32 bits. The source aborts on keys which don't match, so
+// this header and all code including it must be rebuilt whenever the sysprop
+// file changes.
+namespace internal {
+
+std::optional<std::int32_t> GetInteger(std::uint64_t key);
+bool SetInteger(std::uint64_t key, const std::optional<std::int32_t>& value);
+std::optional<std::int32_t> GetEnum(std::uint64_t key);
+bool SetEnum(std::uint64_t key, const std::optional<std::int32_t>& value);
+std::optional<bool> GetBoolean(std::uint64_t key);
+bool SetBoolean(std::uint64_t key, const std::optional<bool>& value);
+std::vector<std::optional<std::int32_t>> GetEnumList(std::uint64_t key);
+bool SetEnumList(std::uint64_t key, const std::vector<std::optional<std::int32_t>>& value);
+bool SetRawValue(std::uint64_t key, const char* value);
+std::uint64_t GetEnumFlags(std::uint64_t key);
+bool SetEnumFlags(std::uint64_t key, std::uint64_t value);
+
+template <typename E>
+inline std::optional<E> ToEnum(const std::optional<std::int32_t>& value) {
+    return value ? std::make_optional(static_cast<E>(*value)) : std::nullopt;
+}
+
+template <typename E>
+inline std::vector<std::optional<E>> ToEnum(const std::vector<std::optional<std::int32_t>>& value) {
+    std::vector<std::optional<E>> ret;
+    ret.reserve(value.size());
+    for (auto&& element : value) ret.push_back(ToEnum<E>(element));
+    return ret;
+}
+
+template <typename E>
+inline std::optional<std::int32_t> FromEnum(const std::optional<E>& value) {
+    return value ? std::make_optional(static_cast<std::int32_t>(*value)) : std::nullopt;
+}
+
+template <typename E>
+inline std::vector<std::optional<std::int32_t>> FromEnum(const std::vector<std::optional<E>>& value) {
+    std::vector<std::optional<std::int32_t>> ret;
+    ret.reserve(value.size());
+    for (auto&& element : value) ret.push_back(FromEnum(element));
+    return ret;
+}
+
+}  // namespace internal
+
+inline std::optional<std::int32_t> test_int() {
+    return internal::GetInteger(0x14b5f8ec00000000ull);
+}
+inline bool test_int(const std::optional<std::int32_t>& value) {
+    return internal::SetInteger(0x14b5f8ec00000000ull, value);
+}
+template <std::int32_t kValue>
+inline bool test_int() {
+    return internal::SetRawValue(0x14b5f8ec00000000ull, ::sysprop::IntegerString<kValue>::value.data());
+}
+
+enum class test_enum_values {
+    A,
+    B,
+    C,
+};
+
+inline std::optional<test_enum_values> test_enum() {
+    return internal::ToEnum<test_enum_values>(internal::GetEnum(0x05980a1d00000001ull));
+}
+inline bool test_enum(const std::optional<test_enum_values>& value) {
+    return internal::SetEnum(0x05980a1d00000001ull, internal::FromEnum(value));
+}
+template <test_enum_values kValue>
+inline bool test_enum() {
+    constexpr const char* kValues[] = {"a", "b", "c"};
+    static_assert(static_cast<std::size_t>(kValue) < sizeof(kValues) / sizeof(kValues[0]), "Invalid value for property android.test.enum");
+    return internal::SetRawValue(0x05980a1d00000001ull, kValues[static_cast<std::size_t>(kValue)]);
+}
+
+inline std::optional<bool> test_bool() {
+    return internal::GetBoolean(0xb6ed6a4300000002ull);
+}
+inline bool test_bool(const std::optional<bool>& value) {
+    return internal::SetBoolean(0xb6ed6a4300000002ull, value);
+}
+template <bool kValue>
+inline bool test_bool() {
+    return internal::SetRawValue(0xb6ed6a4300000002ull, kValue ? "1" : "0");
+}
+
+enum class test_features_values {
+    X,
+    Y,
+    Z,
+};
+
+inline std::vector<std::optional<test_features_values>> test_features() {
+    return internal::ToEnum<test_features_values>(internal::GetEnumList(0xb313ae6700000004ull));
+}
+inline bool test_features(const std::vector<std::optional<test_features_values>>& value) {
+    return internal::SetEnumList(0xb313ae6700000004ull, internal::FromEnum(value));
+}
+inline ::sysprop::EnumFlags<test_features_values> test_features_flags() {
+    return ::sysprop::EnumFlags<test_features_values>(internal::GetEnumFlags(0xb313ae6700000004ull));
+}
+inline bool test_features_flags(const ::sysprop::EnumFlags<test_features_values>& value) {
+    return internal::SetEnumFlags(0xb313ae6700000004ull, value.bits());
+}
+
+}  // namespace android::sysprop::TableProperties
+)";
+
+constexpr const char* kExpectedTableDrivenSourceOutput =
+    R"(// Generated by the sysprop generator. DO NOT EDIT!
+
+#include <properties/TableProperties.sysprop.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include <strings.h>
+#include <sys/system_properties.h>
+
+#include <android-base/parseint.h>
+#include <log/log.h>
+
+namespace {
+
+using namespace android::sysprop::TableProperties;
+
+enum PropType : std::uint8_t {
+    kInteger,
+    kEnum,
+    kBoolean,
+    kStringList,
+    kEnumList,
+};
+
+constexpr std::uint8_t kIntegerAsBool = 1 << 0;
+
+struct PropDescriptor {
+    std::uint32_t name_offset;
+    std::uint32_t name_hash;
+    std::uint16_t enum_table;
+    PropType type;
+    std::uint8_t flags;
+};
+
+struct EnumTable {
+    std::uint32_t first;
+    std::uint32_t count;
+};
+
+constexpr const char kPropNames[] =
+    "android.test_int\0"
+    "android.test.enum\0"
+    "ro.android.test.b\0"
+    "ro.android.test.strlist\0"
+    "android.test.features\0";
+
+constexpr const PropDescriptor kProps[] = {
+    {0, 0x14b5f8ec, 0, kInteger, 0},
+    {17, 0x05980a1d, 0, kEnum, 0},
+    {35, 0xb6ed6a43, 0, kBoolean, kIntegerAsBool},
+    {53, 0x6334b066, 0, kStringList, 0},
+    {77, 0xb313ae67, 1, kEnumList, 0},
+};
+
+constexpr const char kEnumValueNames[] =
+    "a\0"
+    "b\0"
+    "c\0"
+    "x\0"
+    "y\0"
+    "z\0";
+
+constexpr const std::uint32_t kEnumValueOffsets[] = {
+    0,
+    2,
+    4,
+    6,
+    8,
+    10,
+};
+
+constexpr const EnumTable kEnumTables[] = {
+    {0, 3},
+    {3, 3},
+};
+
+std::uint32_t GetPropIndex(std::uint64_t key) {
+    std::uint32_t index = static_cast<std::uint32_t>(key);
+    LOG_ALWAYS_FATAL_IF(index >= sizeof(kProps) / sizeof(kProps[0]) || kProps[index].name_hash != key >> 32,
+                        "Invalid property key %llx", static_cast<unsigned long long>(key));
+    return index;
+}
+
+const char* GetPropName(std::uint32_t index, PropType type) {
+    LOG_ALWAYS_FATAL_IF(kProps[index].type != type, "Invalid property index %u for type %d", index, type);
+    return kPropNames + kProps[index].name_offset;
+}
+
+void DoParse(const char* str, std::optional<bool>* out) {
+    static constexpr const char* kYes[] = {"1", "true"};
+    static constexpr const char* kNo[] = {"0", "false"};
+
+    for (const char* yes : kYes) {
+        if (strcasecmp(yes, str) == 0) {
+            *out = true;
+            return;
+        }
+    }
+
+    for (const char* no : kNo) {
+        if (strcasecmp(no, str) == 0) {
+            *out = false;
+            return;
+        }
+    }
+
+    *out = std::nullopt;
+}
+
+void DoParse(const char* str, std::optional<std::int32_t>* out) {
+    std::int32_t ret;
+    *out = android::base::ParseInt(str, &ret) ? std::make_optional(ret) : std::nullopt;
+}
+
+std::string FormatValue(const std::optional<std::int32_t>& value) {
+    return value ? std::to_string(*value) : "";
+}
+
+void DoParse(const char* str, std::optional<std::string>* out) {
+    *out = *str == '\0' ? std::nullopt : std::make_optional(str);
+}
+
+std::vector<std::string> SplitListValue(const char* str) {
+    std::vector<std::string> ret;
+    if (*str == '\0') return ret;
+    const char* p = str;
+    for (;;) {
+        const char* r = p;
+        std::string value;
+        while (*r != ',') {
+            if (*r == '\\') ++r;
+            if (*r == '\0') break;
+            value += *r++;
+        }
+        ret.emplace_back(std::move(value));
+        if (*r == '\0') break;
+        p = r + 1;
+    }
+    return ret;
+}
+
+void DoParse(const char* str, std::vector<std::optional<std::string>>* out) {
+    for (const std::string& element : SplitListValue(str)) {
+        DoParse(element.c_str(), &out->emplace_back());
+    }
+}
+
+void GetProp(const char* key, std::optional<std::int32_t>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<std::int32_t>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, std::optional<std::string>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<std::string>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, std::optional<bool>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<bool>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, std::vector<std::optional<std::string>>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::vector<std::optional<std::string>>*>(cookie));
+        }, value);
+    }
+}
+
+std::optional<std::int32_t> ParseEnum(std::uint16_t table, const std::optional<std::string>& value) {
+    if (!value) return std::nullopt;
+    const EnumTable& enum_table = kEnumTables[table];
+    for (std::uint32_t i = 0; i < enum_table.count; ++i) {
+        if (*value == kEnumValueNames + kEnumValueOffsets[enum_table.first + i]) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+const char* FormatEnum(std::uint16_t table, std::int32_t value, const char* name) {
+    const EnumTable& enum_table = kEnumTables[table];
+    LOG_ALWAYS_FATAL_IF(value < 0 || static_cast<std::uint32_t>(value) >= enum_table.count,
+                        "Invalid value %d for property %s", value, name);
+    return kEnumValueNames + kEnumValueOffsets[enum_table.first + value];
+}
+
+std::string FormatEnumList(std::uint16_t table, const std::vector<std::optional<std::int32_t>>& value,
+                           const char* name) {
+    std::string ret;
+    bool first = true;
+
+    for (auto&& element : value) {
+        if (!first) ret += ',';
+        else first = false;
+        if (element) ret += FormatEnum(table, *element, name);
+    }
+
+    return ret;
+}
+
+std::uint64_t ParseEnumFlags(std::uint16_t table, const char* str) {
+    const EnumTable& enum_table = kEnumTables[table];
+    std::uint64_t ret = 0;
+    while (*str != '\0') {
+        const char* end = std::strchr(str, ',');
+        std::size_t size = end != nullptr ? end - str : std::strlen(str);
+        for (std::uint32_t i = 0; i < enum_table.count; ++i) {
+            const char* name = kEnumValueNames + kEnumValueOffsets[enum_table.first + i];
+            if (std::strncmp(str, name, size) == 0 && name[size] == '\0') {
+                ret |= std::uint64_t{1} << i;
+                break;
+            }
+        }
+        if (end == nullptr) break;
+        str = end + 1;
+    }
+    return ret;
+}
+
+std::string FormatEnumFlags(std::uint16_t table, std::uint64_t value) {
+    const EnumTable& enum_table = kEnumTables[table];
+    std::string ret;
+    for (std::uint32_t i = 0; i < enum_table.count; ++i) {
+        if ((value & (std::uint64_t{1} << i)) == 0) continue;
+        if (!ret.empty()) ret += ',';
+        ret += kEnumValueNames + kEnumValueOffsets[enum_table.first + i];
+    }
+    return ret;
+}
+
+}  // namespace
+
+namespace android::sysprop::TableProperties::internal {
+
+std::optional<std::int32_t> GetInteger(std::uint64_t key) {
+    std::uint32_t index = GetPropIndex(key);
+    std::optional<std::int32_t> ret;
+    GetProp(GetPropName(index, kInteger), &ret);
+    return ret;
+}
+
+bool SetInteger(std::uint64_t key, const std::optional<std::int32_t>& value) {
+    std::uint32_t index = GetPropIndex(key);
+    const char* name = GetPropName(index, kInteger);
+    return __system_property_set(name, FormatValue(value).c_str()) == 0;
+}
+
+std::optional<std::int32_t> GetEnum(std::uint64_t key) {
+    std::uint32_t index = GetPropIndex(key);
+    std::optional<std::string> value;
+    GetProp(GetPropName(index, kEnum), &value);
+    return ParseEnum(kProps[index].enum_table, value);
+}
+
+bool SetEnum(std::uint64_t key, const std::optional<std::int32_t>& value) {
+    std::uint32_t index = GetPropIndex(key);
+    const char* name = GetPropName(index, kEnum);
+    return __system_property_set(name, value ? FormatEnum(kProps[index].enum_table, *value, name) : "") == 0;
+}
+
+std::optional<bool> GetBoolean(std::uint64_t key) {
+    std::uint32_t index = GetPropIndex(key);
+    std::optional<bool> ret;
+    GetProp(GetPropName(index, kBoolean), &ret);
+    return ret;
+}
+
+bool SetBoolean(std::uint64_t key, const std::optional<bool>& value) {
+    std::uint32_t index = GetPropIndex(key);
+    const char* name = GetPropName(index, kBoolean);
+    return __system_property_set(name, value ? (*value ? "1" : "0") : "") == 0;
+}
+
+std::vector<std::optional<std::string>> GetStringList(std::uint64_t key) {
+    std::uint32_t index = GetPropIndex(key);
+    std::vector<std::optional<std::string>> ret;
+    GetProp(GetPropName(index, kStringList), &ret);
+    return ret;
+}
+
+std::vector<std::optional<std::int32_t>> GetEnumList(std::uint64_t key) {
+    std::uint32_t index = GetPropIndex(key);
+    std::vector<std::optional<std::string>> values;
+    GetProp(GetPropName(index, kEnumList), &values);
+    std::vector<std::optional<std::int32_t>> ret;
+    ret.reserve(values.size());
+    for (auto&& value : values) {
+        ret.push_back(ParseEnum(kProps[index].enum_table, value));
+    }
+    return ret;
+}
+
+bool SetEnumList(std::uint64_t key, const std::vector<std::optional<std::int32_t>>& value) {
+    std::uint32_t index = GetPropIndex(key);
+    const char* name = GetPropName(index, kEnumList);
+    return __system_property_set(name, FormatEnumList(kProps[index].enum_table, value, name).c_str()) == 0;
+}
+
+bool SetRawValue(std::uint64_t key, const char* value) {
+    std::uint32_t index = GetPropIndex(key);
+    return __system_property_set(kPropNames + kProps[index].name_offset, value) == 0;
+}
+
+std::uint64_t GetEnumFlags(std::uint64_t key) {
+    std::uint32_t index = GetPropIndex(key);
+    std::optional<std::string> value;
+    GetProp(GetPropName(index, kEnumList), &value);
+    return value ? ParseEnumFlags(kProps[index].enum_table, value->c_str()) : 0;
+}
+
+bool SetEnumFlags(std::uint64_t key, std::uint64_t value) {
+    std::uint32_t index = GetPropIndex(key);
+    const char* name = GetPropName(index, kEnumList);
+    return __system_property_set(name, FormatEnumFlags(kProps[index].enum_table, value).c_str()) == 0;
+}
+
+}  // namespace android::sysprop::TableProperties::internal
+)";
+
+constexpr const char* kTestInstrumentedSyspropFile =
+    R"(owner: Platform
+module: "android.sysprop.InstrumentedProperties"
+prop {
+    api_name: "test_int"
+    type: Integer
+    prop_name: "android.test_int"
+    scope: Public
+    access: ReadWrite
+}
+prop {
+    api_name: "test_string"
+    type: String
+    prop_name: "ro.android.test.string"
+    scope: Internal
+    access: Readonly
+}
+)";
+
+constexpr const char* kExpectedInstrumentedHeaderOutput =
+    R"(// Generated by the sysprop generator. DO NOT EDIT!
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/system_properties.h>
+
+#ifndef SYSPROP_INTEGER_STRING_DEFINED
+#define SYSPROP_INTEGER_STRING_DEFINED
+
+namespace sysprop {
+
+template <std::int64_t kValue>
+struct IntegerString {
+    static constexpr std::size_t Size() {
+        std::size_t size = kValue <= 0 ? 1 : 0;
+        for (std::int64_t v = kValue; v != 0; v /= 10) ++size;
+        return size;
+    }
+
+    static constexpr std::array<char, Size() + 1> Format() {
+        std::array<char, Size() + 1> ret{};
+        std::int64_t v = kValue;
+        std::size_t i = Size();
+        do {
+            int digit = static_cast<int>(v % 10);
+            ret[--i] = static_cast<char>('0' + (digit < 0 ? -digit : digit));
+            v /= 10;
+        } while (v != 0);
+        if (kValue < 0) ret[0] = '-';
+        return ret;
+    }
+
+    static constexpr std::array<char, Size() + 1> value = Format();
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_INTEGER_STRING_DEFINED
+
+namespace android::sysprop::InstrumentedProperties {
+
+std::optional<std::int32_t> test_int();
+bool test_int(const std::optional<std::int32_t>& value);
+template <std::int32_t kValue>
+inline bool test_int() {
+    return __system_property_set("android.test_int", ::sysprop::IntegerString<kValue>::value.data()) == 0;
+}
+
+std::optional<std::string> test_string();
+
+// Property changes observed by getters in this process. total_changes counts
+// every change since the process started. At most 16 recent changes are kept
+// per property; recent_values counts the distinct values among them, so a
+// flapping property has many changes but few values. changes_per_second is
+// averaged over the window, or over the span of the kept changes when older
+// changes in the window were dropped.
+struct PropChangeStats {
+    const char* prop_name;
+    std::uint64_t total_changes;
+    std::uint32_t recent_changes;
+    std::uint32_t recent_values;
+    double changes_per_second;
+};
+
+// Pass std::numeric_limits<std::uint64_t>::max() as window_ns for all of the
+// recent changes which are kept.
+std::vector<PropChangeStats> GetPropChangeStats(std::uint64_t window_ns);
+
+}  // namespace android::sysprop::InstrumentedProperties
+)";
+
+constexpr const char* kExpectedInstrumentedPublicHeaderOutput =
+    R"(// Generated by the sysprop generator. DO NOT EDIT!
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/system_properties.h>
+
+#ifndef SYSPROP_INTEGER_STRING_DEFINED
+#define SYSPROP_INTEGER_STRING_DEFINED
+
+namespace sysprop {
+
+template <std::int64_t kValue>
+struct IntegerString {
+    static constexpr std::size_t Size() {
+        std::size_t size = kValue <= 0 ? 1 : 0;
+        for (std::int64_t v = kValue; v != 0; v /= 10) ++size;
+        return size;
+    }
+
+    static constexpr std::array<char, Size() + 1> Format() {
+        std::array<char, Size() + 1> ret{};
+        std::int64_t v = kValue;
+        std::size_t i = Size();
+        do {
+            int digit = static_cast<int>(v % 10);
+            ret[--i] = static_cast<char>('0' + (digit < 0 ? -digit : digit));
+            v /= 10;
+        } while (v != 0);
+        if (kValue < 0) ret[0] = '-';
+        return ret;
+    }
+
+    static constexpr std::array<char, Size() + 1> value = Format();
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_INTEGER_STRING_DEFINED
+
+namespace android::sysprop::InstrumentedProperties {
+
+std::optional<std::int32_t> test_int();
+bool test_int(const std::optional<std::int32_t>& value);
+template <std::int32_t kValue>
+inline bool test_int() {
+    return __system_property_set("android.test_int", ::sysprop::IntegerString<kValue>::value.data()) == 0;
+}
+
+// Property changes observed by getters in this process. total_changes counts
+// every change since the process started. At most 16 recent changes are kept
+// per property; recent_values counts the distinct values among them, so a
+// flapping property has many changes but few values. changes_per_second is
+// averaged over the window, or over the span of the kept changes when older
+// changes in the window were dropped.
+struct PropChangeStats {
+    const char* prop_name;
+    std::uint64_t total_changes;
+    std::uint32_t recent_changes;
+    std::uint32_t recent_values;
+    double changes_per_second;
+};
+
+// Pass std::numeric_limits<std::uint64_t>::max() as window_ns for all of the
+// recent changes which are kept.
+std::vector<PropChangeStats> GetPropChangeStats(std::uint64_t window_ns);
+
+}  // namespace android::sysprop::InstrumentedProperties
+)";
+
+constexpr const char* kExpectedInstrumentedSourceOutput =
+    R"(// Generated by the sysprop generator. DO NOT EDIT!
+
+#include <properties/InstrumentedProperties.sysprop.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include <strings.h>
+#include <sys/system_properties.h>
+
+#include <android-base/parseint.h>
+#include <log/log.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace {
+
+using namespace android::sysprop::InstrumentedProperties;
+
+constexpr std::size_t kChangeHistorySize = 16;
+
+struct ChangeRecord {
+    std::atomic<std::uint64_t> sequence;
+    std::atomic<std::uint64_t> timestamp_ns;
+    std::atomic<std::uint32_t> serial;
+    std::atomic<std::uint32_t> value_hash;
+};
+
+struct ChangeHistory {
+    std::atomic<std::uint32_t> last_serial;
+    std::atomic<std::uint64_t> count;
+    ChangeRecord records[kChangeHistorySize];
+};
+
+std::uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::uint32_t HashValue(const char* value) {
+    std::uint32_t hash = 2166136261u;
+    for (; *value != '\0'; ++value) {
+        hash = (hash ^ static_cast<unsigned char>(*value)) * 16777619u;
+    }
+    return hash;
+}
+
+// Serials keep the value length in their top 8 bits and a counter in the
+// low 24 bits, so they're ordered by the counter, allowing for wraparound.
+bool IsNewerSerial(std::uint32_t serial, std::uint32_t last) {
+    return static_cast<std::int32_t>((serial - last) << 8) > 0;
+}
+
+// The first observation only sets the baseline. Readers which raced with a
+// newer observation drop theirs, so stale values are never recorded.
+void RecordChange(ChangeHistory* history, std::uint32_t serial, const char* value) {
+    std::uint32_t last = history->last_serial.load(std::memory_order_relaxed);
+    do {
+        if (last != 0 && !IsNewerSerial(serial, last)) return;
+    } while (!history->last_serial.compare_exchange_weak(last, serial, std::memory_order_relaxed));
+    if (last == 0) return;
+
+    std::uint64_t index = history->count.fetch_add(1, std::memory_order_relaxed);
+    ChangeRecord& record = history->records[index % kChangeHistorySize];
+    record.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    record.timestamp_ns.store(NowNs(), std::memory_order_relaxed);
+    record.serial.store(serial, std::memory_order_relaxed);
+    record.value_hash.store(HashValue(value), std::memory_order_relaxed);
+    record.sequence.store(index + 1, std::memory_order_release);
+}
+
+PropChangeStats CollectChangeStats(const char* name, const ChangeHistory& history,
+                                   std::uint64_t now, std::uint64_t window_ns) {
+    PropChangeStats stats{name, history.count.load(std::memory_order_relaxed), 0, 0, 0.0};
+    std::uint32_t hashes[kChangeHistorySize];
+    std::uint64_t oldest_ns = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t newest_ns = 0;
+
+    for (const ChangeRecord& record : history.records) {
+        std::uint64_t sequence = record.sequence.load(std::memory_order_acquire);
+        std::uint64_t timestamp_ns = record.timestamp_ns.load(std::memory_order_relaxed);
+        std::uint32_t value_hash = record.value_hash.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence == 0 || record.sequence.load(std::memory_order_relaxed) != sequence) continue;
+        // Records written after now was taken are in the window too.
+        if (timestamp_ns < now && now - timestamp_ns > window_ns) continue;
+
+        bool seen = false;
+        for (std::uint32_t i = 0; i < stats.recent_changes; ++i) {
+            if (hashes[i] == value_hash) seen = true;
+        }
+        if (!seen) ++stats.recent_values;
+        hashes[stats.recent_changes++] = value_hash;
+        oldest_ns = std::min(oldest_ns, timestamp_ns);
+        newest_ns = std::max(newest_ns, timestamp_ns);
+    }
+
+    // When every record is in the window and older ones were overwritten, the
+    // window holds more changes than were kept, so the rate is taken over the
+    // span of the records instead.
+    if (stats.recent_changes == kChangeHistorySize && stats.total_changes > kChangeHistorySize &&
+        newest_ns > oldest_ns) {
+        stats.changes_per_second = (stats.recent_changes - 1) * 1e9 / (newest_ns - oldest_ns);
+    } else if (std::min(window_ns, now) > 0) {
+        // The window can't reach back past the epoch of the steady clock, so
+        // larger windows average over the time since then instead.
+        stats.changes_per_second = stats.recent_changes * 1e9 / std::min(window_ns, now);
+    }
+    return stats;
+}
+
+constexpr const char* kChangeHistoryNames[] = {
+    "android.test_int",
+    "ro.android.test.string",
+};
+
+ChangeHistory gChangeHistories[2];
+
+void DoParse(const char* str, std::optional<std::int32_t>* out) {
+    std::int32_t ret;
+    *out = android::base::ParseInt(str, &ret) ? std::make_optional(ret) : std::nullopt;
+}
+
+std::string FormatValue(const std::optional<std::int32_t>& value) {
+    return value ? std::to_string(*value) : "";
+}
+
+void DoParse(const char* str, std::optional<std::string>* out) {
+    *out = *str == '\0' ? std::nullopt : std::make_optional(str);
+}
+
+void GetProp(const char* key, std::optional<std::int32_t>* value, ChangeHistory* history) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        std::pair<std::optional<std::int32_t>*, ChangeHistory*> cookie(value, history);
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t serial) {
+            auto [out, history] = *static_cast<std::pair<std::optional<std::int32_t>*, ChangeHistory*>*>(cookie);
+            RecordChange(history, serial, value);
+            DoParse(value, out);
+        }, &cookie);
+    }
+}
+
+void GetProp(const char* key, std::optional<std::string>* value, ChangeHistory* history) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        std::pair<std::optional<std::string>*, ChangeHistory*> cookie(value, history);
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t serial) {
+            auto [out, history] = *static_cast<std::pair<std::optional<std::string>*, ChangeHistory*>*>(cookie);
+            RecordChange(history, serial, value);
+            DoParse(value, out);
+        }, &cookie);
+    }
+}
+
+}  // namespace
+
+namespace android::sysprop::InstrumentedProperties {
+
+std::optional<std::int32_t> test_int() {
+    std::optional<std::int32_t> ret;
+    GetProp("android.test_int", &ret, &gChangeHistories[0]);
+    return ret;
+}
+
+bool test_int(const std::optional<std::int32_t>& value) {
+    return __system_property_set("android.test_int", FormatValue(value).c_str()) == 0;
+}
+
+std::optional<std::string> test_string() {
+    std::optional<std::string> ret;
+    GetProp("ro.android.test.string", &ret, &gChangeHistories[1]);
+    return ret;
+}
+
+std::vector<PropChangeStats> GetPropChangeStats(std::uint64_t window_ns) {
+    std::uint64_t now = NowNs();
+    std::vector<PropChangeStats> ret;
+    ret.reserve(2);
+    for (std::size_t i = 0; i < 2; ++i) {
+        ret.push_back(CollectChangeStats(kChangeHistoryNames[i], gChangeHistories[i], now, window_ns));
+    }
+    return ret;
+}
+
+}  // namespace android::sysprop::InstrumentedProperties
+)";
+
+constexpr const char* kExpectedModuleRegistryHeaderOutput =
+    R"(// Generated by the sysprop generator. DO NOT EDIT!
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/system_properties.h>
+
+#include <sysprop/ModuleRegistry.h>
+
+#ifndef SYSPROP_INTEGER_STRING_DEFINED
+#define SYSPROP_INTEGER_STRING_DEFINED
+
+namespace sysprop {
+
+template <std::int64_t kValue>
+struct IntegerString {
+    static constexpr std::size_t Size() {
+        std::size_t size = kValue <= 0 ? 1 : 0;
+        for (std::int64_t v = kValue; v != 0; v /= 10) ++size;
+        return size;
+    }
+
+    static constexpr std::array<char, Size() + 1> Format() {
+        std::array<char, Size() + 1> ret{};
+        std::int64_t v = kValue;
+        std::size_t i = Size();
+        do {
+            int digit = static_cast<int>(v % 10);
+            ret[--i] = static_cast<char>('0' + (digit < 0 ? -digit : digit));
+            v /= 10;
+        } while (v != 0);
+        if (kValue < 0) ret[0] = '-';
+        return ret;
+    }
+
+    static constexpr std::array<char, Size() + 1> value = Format();
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_INTEGER_STRING_DEFINED
+
+namespace android::sysprop::InstrumentedProperties {
+
+std::optional<std::int32_t> test_int();
+bool test_int(const std::optional<std::int32_t>& value);
+template <std::int32_t kValue>
+inline bool test_int() {
+    return __system_property_set("android.test_int", ::sysprop::IntegerString<kValue>::value.data()) == 0;
+}
+
+std::optional<std::string> test_string();
+
+}  // namespace android::sysprop::InstrumentedProperties
+)";
+
+constexpr const char* kExpectedModuleRegistryPublicHeaderOutput =
+    R"(// Generated by the sysprop generator. DO NOT EDIT!
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/system_properties.h>
+
+#include <sysprop/ModuleRegistry.h>
+
+#ifndef SYSPROP_INTEGER_STRING_DEFINED
+#define SYSPROP_INTEGER_STRING_DEFINED
+
+namespace sysprop {
+
+template <std::int64_t kValue>
+struct IntegerString {
+    static constexpr std::size_t Size() {
+        std::size_t size = kValue <= 0 ? 1 : 0;
+        for (std::int64_t v = kValue; v != 0; v /= 10) ++size;
+        return size;
+    }
+
+    static constexpr std::array<char, Size() + 1> Format() {
+        std::array<char, Size() + 1> ret{};
+        std::int64_t v = kValue;
+        std::size_t i = Size();
+        do {
+            int digit = static_cast<int>(v % 10);
+            ret[--i] = static_cast<char>('0' + (digit < 0 ? -digit : digit));
+            v /= 10;
+        } while (v != 0);
+        if (kValue < 0) ret[0] = '-';
+        return ret;
+    }
+
+    static constexpr std::array<char, Size() + 1> value = Format();
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_INTEGER_STRING_DEFINED
+
+namespace android::sysprop::InstrumentedProperties {
+
+std::optional<std::int32_t> test_int();
+bool test_int(const std::optional<std::int32_t>& value);
+template <std::int32_t kValue>
+inline bool test_int() {
+    return __system_property_set("android.test_int", ::sysprop::IntegerString<kValue>::value.data()) == 0;
+}
+
+}  // namespace android::sysprop::InstrumentedProperties
+)";
+
+constexpr const char* kExpectedModuleRegistrySourceOutput =
+    R"(// Generated by the sysprop generator. DO NOT EDIT!
+
+#include <properties/InstrumentedProperties.sysprop.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include <strings.h>
+#include <sys/system_properties.h>
+
+#include <android-base/parseint.h>
+#include <log/log.h>
+
+namespace {
+
+using namespace android::sysprop::InstrumentedProperties;
+
+constexpr const char* kRegisteredPropNames[] = {
+    "android.test_int",
+    "ro.android.test.string",
+};
+
+std::atomic<const prop_info*> gPropHandles[2];
+
+const prop_info* FindProp(std::uint32_t index, const char* name) {
+    const prop_info* pi = gPropHandles[index].load(std::memory_order_acquire);
+    if (pi != nullptr) return pi;
+    pi = __system_property_find(name);
+    if (pi != nullptr) gPropHandles[index].store(pi, std::memory_order_release);
+    return pi;
+}
+
+const ::sysprop::ModuleDescriptor kModuleDescriptor = {
+    "android.sysprop.InstrumentedProperties", 2, kRegisteredPropNames, gPropHandles, nullptr,
+};
+
+const ::sysprop::ModuleRegistration kModuleRegistration(&kModuleDescriptor);
+
+void DoParse(const char* str, std::optional<std::int32_t>* out) {
+    std::int32_t ret;
+    *out = android::base::ParseInt(str, &ret) ? std::make_optional(ret) : std::nullopt;
+}
+
+std::string FormatValue(const std::optional<std::int32_t>& value) {
+    return value ? std::to_string(*value) : "";
+}
+
+void DoParse(const char* str, std::optional<std::string>* out) {
+    *out = *str == '\0' ? std::nullopt : std::make_optional(str);
+}
+
+void GetProp(const prop_info* pi, std::optional<std::int32_t>* value) {
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<std::int32_t>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const prop_info* pi, std::optional<std::string>* value) {
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<std::string>*>(cookie));
+        }, value);
+    }
+}
+
+}  // namespace
+
+namespace android::sysprop::InstrumentedProperties {
+
+std::optional<std::int32_t> test_int() {
+    std::optional<std::int32_t> ret;
+    GetProp(FindProp(0, "android.test_int"), &ret);
+    return ret;
+}
+
+bool test_int(const std::optional<std::int32_t>& value) {
+    return __system_property_set("android.test_int", FormatValue(value).c_str()) == 0;
+}
+
+std::optional<std::string> test_string() {
+    std::optional<std::string> ret;
+    GetProp(FindProp(1, "ro.android.test.string"), &ret);
+    return ret;
+}
+
+}  // namespace android::sysprop::InstrumentedProperties
+)";
+
+}  // namespace
+
+using namespace std::string_literals;
+
+constexpr const char* kTestSnapshotSyspropFile =
+    R"(owner: Platform
+module: "android.sysprop.SnapshotProperties"
+prop {
+    api_name: "test_int"
+    type: Integer
+    prop_name: "android.test_int"
+    scope: Public
+    access: ReadWrite
+}
+prop {
+    api_name: "test_enum"
+    type: Enum
+    prop_name: "ro.android.test.enum"
+    scope: Internal
+    access: Readonly
+    enum_values: "a|b|c"
+}
+prop {
+    api_name: "test_list"
+    type: StringList
+    prop_name: "android.test.list"
+    scope: Internal
+    access: ReadWrite
+}
+)";
+
+constexpr const char* kExpectedSnapshotHeaderOutput =
+    R"(// Generated by the sysprop generator. DO NOT EDIT!
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/system_properties.h>
+
+#ifndef SYSPROP_INTEGER_STRING_DEFINED
+#define SYSPROP_INTEGER_STRING_DEFINED
+
+namespace sysprop {
+
+template <std::int64_t kValue>
+struct IntegerString {
+    static constexpr std::size_t Size() {
+        std::size_t size = kValue <= 0 ? 1 : 0;
+        for (std::int64_t v = kValue; v != 0; v /= 10) ++size;
+        return size;
+    }
+
+    static constexpr std::array<char, Size() + 1> Format() {
+        std::array<char, Size() + 1> ret{};
+        std::int64_t v = kValue;
+        std::size_t i = Size();
+        do {
+            int digit = static_cast<int>(v % 10);
+            ret[--i] = static_cast<char>('0' + (digit < 0 ? -digit : digit));
+            v /= 10;
+        } while (v != 0);
+        if (kValue < 0) ret[0] = '-';
+        return ret;
+    }
+
+    static constexpr std::array<char, Size() + 1> value = Format();
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_INTEGER_STRING_DEFINED
+
+namespace android::sysprop::SnapshotProperties {
+
+std::optional<std::int32_t> test_int();
+bool test_int(const std::optional<std::int32_t>& value);
+template <std::int32_t kValue>
+inline bool test_int() {
+    return __system_property_set("android.test_int", ::sysprop::IntegerString<kValue>::value.data()) == 0;
+}
+
+enum class test_enum_values {
+    A,
+    B,
+    C,
+};
+
+std::optional<test_enum_values> test_enum();
+
+std::vector<std::optional<std::string>> test_list();
+bool test_list(const std::vector<std::optional<std::string>>& value);
+
+struct Snapshot {
+    std::optional<std::int32_t> test_int;
+    std::optional<test_enum_values> test_enum;
+    std::vector<std::optional<std::string>> test_list;
+};
+
+Snapshot ReadSnapshot();
+std::string SerializeSnapshot(const Snapshot& snapshot);
+std::optional<Snapshot> DeserializeSnapshot(std::string_view data);
+
+}  // namespace android::sysprop::SnapshotProperties
+)";
+
+constexpr const char* kExpectedSnapshotPublicHeaderOutput =
+    R"(// Generated by the sysprop generator. DO NOT EDIT!
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/system_properties.h>
+
+#ifndef SYSPROP_INTEGER_STRING_DEFINED
+#define SYSPROP_INTEGER_STRING_DEFINED
+
+namespace sysprop {
+
+template <std::int64_t kValue>
+struct IntegerString {
+    static constexpr std::size_t Size() {
+        std::size_t size = kValue <= 0 ? 1 : 0;
+        for (std::int64_t v = kValue; v != 0; v /= 10) ++size;
+        return size;
+    }
+
+    static constexpr std::array<char, Size() + 1> Format() {
+        std::array<char, Size() + 1> ret{};
+        std::int64_t v = kValue;
+        std::size_t i = Size();
+        do {
+            int digit = static_cast<int>(v % 10);
+            ret[--i] = static_cast<char>('0' + (digit < 0 ? -digit : digit));
+            v /= 10;
+        } while (v != 0);
+        if (kValue < 0) ret[0] = '-';
+        return ret;
+    }
+
+    static constexpr std::array<char, Size() + 1> value = Format();
+};
+
+}  // namespace sysprop
+
+#endif  // SYSPROP_INTEGER_STRING_DEFINED
+
+namespace android::sysprop::SnapshotProperties {
+
+std::optional<std::int32_t> test_int();
+bool test_int(const std::optional<std::int32_t>& value);
+template <std::int32_t kValue>
+inline bool test_int() {
+    return __system_property_set("android.test_int", ::sysprop::IntegerString<kValue>::value.data()) == 0;
+}
+
+}  // namespace android::sysprop::SnapshotProperties
+)";
+
+constexpr const char* kExpectedSnapshotSourceOutput =
+    R"(// Generated by the sysprop generator. DO NOT EDIT!
+
+#include <properties/SnapshotProperties.sysprop.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include <strings.h>
+#include <sys/system_properties.h>
+
+#include <android-base/parseint.h>
+#include <log/log.h>
+
+namespace {
+
+using namespace android::sysprop::SnapshotProperties;
+
+constexpr const std::pair<const char*, test_enum_values> test_enum_list[] = {
+    {"a", test_enum_values::A},
+    {"b", test_enum_values::B},
+    {"c", test_enum_values::C},
+};
+
+void DoParse(const char* str, std::optional<test_enum_values>* out) {
+    for (auto [name, val] : test_enum_list) {
+        if (strcmp(str, name) == 0) {
+            *out = val;
+            return;
+        }
+    }
+    *out = std::nullopt;
+}
+
+void DoParse(const char* str, std::optional<std::int32_t>* out) {
+    std::int32_t ret;
+    *out = android::base::ParseInt(str, &ret) ? std::make_optional(ret) : std::nullopt;
+}
+
+std::string FormatValue(const std::optional<std::int32_t>& value) {
+    return value ? std::to_string(*value) : "";
+}
+
+void DoParse(const char* str, std::optional<std::string>* out) {
+    *out = *str == '\0' ? std::nullopt : std::make_optional(str);
+}
+
+std::vector<std::string> SplitListValue(const char* str) {
+    std::vector<std::string> ret;
+    if (*str == '\0') return ret;
+    const char* p = str;
+    for (;;) {
+        const char* r = p;
+        std::string value;
+        while (*r != ',') {
+            if (*r == '\\') ++r;
+            if (*r == '\0') break;
+            value += *r++;
+        }
+        ret.emplace_back(std::move(value));
+        if (*r == '\0') break;
+        p = r + 1;
+    }
+    return ret;
+}
+
+void DoParse(const char* str, std::vector<std::optional<std::string>>* out) {
+    for (const std::string& element : SplitListValue(str)) {
+        DoParse(element.c_str(), &out->emplace_back());
+    }
+}
+
+std::string FormatValue(const std::vector<std::optional<std::string>>& value) {
+    std::string ret;
+    bool first = true;
+
+    for (auto&& element : value) {
+        if (!first) ret += ',';
+        else first = false;
+        if (element) {
+            for (char c : *element) {
+                if (c == '\\' || c == ',') ret += '\\';
+                ret += c;
+            }
+        }
+    }
+
+    return ret;
+}
+
+void GetProp(const char* key, std::optional<std::int32_t>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<std::int32_t>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, std::optional<test_enum_values>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<test_enum_values>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const char* key, std::vector<std::optional<std::string>>* value) {
+    auto pi = __system_property_find(key);
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::vector<std::optional<std::string>>*>(cookie));
+        }, value);
+    }
+}
+
+constexpr std::uint64_t kSnapshotVersion = 1;
+
+void PutVarint(std::string* out, std::uint64_t value) {
+    while (value >= 0x80) {
+        *out += static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    *out += static_cast<char>(value);
+}
+
+bool GetVarint(std::string_view* in, std::uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (in->empty()) return false;
+        std::uint8_t byte = in->front();
+        in->remove_prefix(1);
+        *value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+void PutFixed64(std::string* out, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) *out += static_cast<char>(value >> (i * 8));
+}
+
+bool GetFixed64(std::string_view* in, std::uint64_t* value) {
+    if (in->size() < 8) return false;
+    *value = 0;
+    for (int i = 0; i < 8; ++i) {
+        *value |= static_cast<std::uint64_t>(static_cast<std::uint8_t>((*in)[i])) << (i * 8);
+    }
+    in->remove_prefix(8);
+    return true;
+}
+
+bool GetPresence(std::string_view* in, bool* present) {
+    std::uint64_t raw;
+    if (!GetVarint(in, &raw) || raw > 1) return false;
+    *present = raw == 1;
+    return true;
+}
+
+void PutPayload(std::string* out, std::int32_t value) {
+    PutVarint(out, (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31));
+}
+
+bool GetPayload(std::string_view* in, std::int32_t* value) {
+    std::uint64_t raw;
+    if (!GetVarint(in, &raw) || raw > std::numeric_limits<std::uint32_t>::max()) return false;
+    *value = static_cast<std::int32_t>((raw >> 1) ^ (~(raw & 1) + 1));
+    return true;
+}
+
+void PutPayload(std::string* out, const std::string& value) {
+    PutVarint(out, value.size());
+    *out += value;
+}
+
+bool GetPayload(std::string_view* in, std::string* value) {
+    std::uint64_t size;
+    if (!GetVarint(in, &size) || size > in->size()) return false;
+    value->assign(in->data(), size);
+    in->remove_prefix(size);
+    return true;
+}
+
+void PutPayload(std::string* out, test_enum_values value) {
+    PutVarint(out, static_cast<std::uint64_t>(value));
+}
+
+bool GetPayload(std::string_view* in, test_enum_values* value) {
+    std::uint64_t raw;
+    if (!GetVarint(in, &raw) || raw >= 3) return false;
+    *value = static_cast<test_enum_values>(raw);
+    return true;
+}
+
+void PutValue(std::string* out, const std::optional<std::int32_t>& value) {
+    *out += static_cast<char>(value.has_value());
+    if (value) PutPayload(out, *value);
+}
+
+bool GetValue(std::string_view* in, std::optional<std::int32_t>* value) {
+    bool present;
+    if (!GetPresence(in, &present)) return false;
+    if (!present) {
+        *value = std::nullopt;
+        return true;
+    }
+    return GetPayload(in, &value->emplace());
+}
+
+void PutValue(std::string* out, const std::optional<std::string>& value) {
+    *out += static_cast<char>(value.has_value());
+    if (value) PutPayload(out, *value);
+}
+
+bool GetValue(std::string_view* in, std::optional<std::string>* value) {
+    bool present;
+    if (!GetPresence(in, &present)) return false;
+    if (!present) {
+        *value = std::nullopt;
+        return true;
+    }
+    return GetPayload(in, &value->emplace());
+}
+
+void PutValue(std::string* out, const std::optional<test_enum_values>& value) {
+    *out += static_cast<char>(value.has_value());
+    if (value) PutPayload(out, *value);
+}
+
+bool GetValue(std::string_view* in, std::optional<test_enum_values>* value) {
+    bool present;
+    if (!GetPresence(in, &present)) return false;
+    if (!present) {
+        *value = std::nullopt;
+        return true;
+    }
+    return GetPayload(in, &value->emplace());
+}
+
+void PutValue(std::string* out, const std::vector<std::optional<std::string>>& value) {
+    PutVarint(out, value.size());
+    for (auto&& element : value) PutValue(out, element);
+}
+
+bool GetValue(std::string_view* in, std::vector<std::optional<std::string>>* value) {
+    std::uint64_t size;
+    if (!GetVarint(in, &size) || size > in->size()) return false;
+    value->resize(size);
+    for (auto& element : *value) {
+        if (!GetValue(in, &element)) return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+namespace android::sysprop::SnapshotProperties {
+
+std::optional<std::int32_t> test_int() {
+    std::optional<std::int32_t> ret;
+    GetProp("android.test_int", &ret);
+    return ret;
+}
+
+bool test_int(const std::optional<std::int32_t>& value) {
+    return __system_property_set("android.test_int", FormatValue(value).c_str()) == 0;
+}
+
+std::optional<test_enum_values> test_enum() {
+    std::optional<test_enum_values> ret;
+    GetProp("ro.android.test.enum", &ret);
+    return ret;
+}
+
+std::vector<std::optional<std::string>> test_list() {
+    std::vector<std::optional<std::string>> ret;
+    GetProp("android.test.list", &ret);
+    return ret;
+}
+
+bool test_list(const std::vector<std::optional<std::string>>& value) {
+    return __system_property_set("android.test.list", FormatValue(value).c_str()) == 0;
+}
+
+Snapshot ReadSnapshot() {
+    Snapshot ret;
+    ret.test_int = test_int();
+    ret.test_enum = test_enum();
+    ret.test_list = test_list();
+    return ret;
+}
+
+std::string SerializeSnapshot(const Snapshot& snapshot) {
+    std::string ret = "SYSP";
+    PutVarint(&ret, kSnapshotVersion);
+    PutFixed64(&ret, 0x754236f68703d874ull);
+    PutValue(&ret, snapshot.test_int);
+    PutValue(&ret, snapshot.test_enum);
+    PutValue(&ret, snapshot.test_list);
+    return ret;
+}
+
+std::optional<Snapshot> DeserializeSnapshot(std::string_view data) {
+    std::uint64_t version;
+    std::uint64_t schema_hash;
+    if (data.substr(0, 4) != "SYSP") return std::nullopt;
+    data.remove_prefix(4);
+    if (!GetVarint(&data, &version) || version != kSnapshotVersion) return std::nullopt;
+    if (!GetFixed64(&data, &schema_hash) || schema_hash != 0x754236f68703d874ull) return std::nullopt;
+    Snapshot ret;
+    if (!GetValue(&data, &ret.test_int)) return std::nullopt;
+    if (!GetValue(&data, &ret.test_enum)) return std::nullopt;
+    if (!GetValue(&data, &ret.test_list)) return std::nullopt;
+    if (!data.empty()) return std::nullopt;
+    return ret;
+}
+
+}  // namespace android::sysprop::SnapshotProperties
+)";
+
+constexpr const char* kTestProfileFile =
+    R"(duration_seconds: 10
+prop {
+    api_name: "test_int"
+    reads: 1000
+    writes: 2
+}
+prop {
+    api_name: "test_string"
+    reads: 50
+}
+prop {
+    api_name: "test_removed"
+    reads: 10
+}
+)";
+
+constexpr const char* kExpectedProfileSourceOutput =
+    R"(// Generated by the sysprop generator. DO NOT EDIT!
+
+#include <properties/InstrumentedProperties.sysprop.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include <strings.h>
+#include <sys/system_properties.h>
+
+#include <android-base/parseint.h>
+#include <log/log.h>
+
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+
+namespace {
+
+using namespace android::sysprop::InstrumentedProperties;
+
+const prop_info* FindCachedProp(std::atomic<const prop_info*>* handle, const char* name) {
+    const prop_info* pi = handle->load(std::memory_order_acquire);
+    if (pi == nullptr) {
+        pi = __system_property_find(name);
+        if (pi != nullptr) handle->store(pi, std::memory_order_release);
+    }
+    return pi;
+}
+
+struct SerialCache {
+    std::mutex lock;
+    std::atomic<std::uint64_t> sequence;
+    std::atomic<std::uint32_t> serial;
+    std::atomic<std::uint64_t> words[2];
+};
+
+bool LoadCached(SerialCache* cache, std::uint32_t serial, void* value, std::size_t size) {
+    std::uint64_t sequence = cache->sequence.load(std::memory_order_acquire);
+    if (sequence == 0 || sequence % 2 != 0) return false;
+    if (cache->serial.load(std::memory_order_relaxed) != serial) return false;
+    std::uint64_t words[2] = {cache->words[0].load(std::memory_order_relaxed),
+                              cache->words[1].load(std::memory_order_relaxed)};
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (cache->sequence.load(std::memory_order_relaxed) != sequence) return false;
+    std::memcpy(value, words, size);
+    return true;
+}
+
+void StoreCached(SerialCache* cache, std::uint32_t serial, const void* value, std::size_t size) {
+    std::uint64_t words[2] = {};
+    std::memcpy(words, value, size);
+    std::lock_guard<std::mutex> guard(cache->lock);
+    std::uint64_t sequence = cache->sequence.load(std::memory_order_relaxed);
+    cache->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    cache->serial.store(serial, std::memory_order_relaxed);
+    cache->words[0].store(words[0], std::memory_order_relaxed);
+    cache->words[1].store(words[1], std::memory_order_relaxed);
+    cache->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void DoParse(const char* str, std::optional<std::int32_t>* out) {
+    std::int32_t ret;
+    *out = android::base::ParseInt(str, &ret) ? std::make_optional(ret) : std::nullopt;
+}
+
+std::string FormatValue(const std::optional<std::int32_t>& value) {
+    return value ? std::to_string(*value) : "";
+}
+
+void DoParse(const char* str, std::optional<std::string>* out) {
+    *out = *str == '\0' ? std::nullopt : std::make_optional(str);
+}
+
+void GetProp(const prop_info* pi, std::optional<std::int32_t>* value) {
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<std::int32_t>*>(cookie));
+        }, value);
+    }
+}
+
+void GetProp(const prop_info* pi, std::optional<std::string>* value) {
+    if (pi != nullptr) {
+        __system_property_read_callback(pi, [](void* cookie, const char*, const char* value, std::uint32_t) {
+            DoParse(value, static_cast<std::optional<std::string>*>(cookie));
+        }, value);
+    }
+}
+
+}  // namespace
+
+namespace android::sysprop::InstrumentedProperties {
+
+std::optional<std::int32_t> test_int() {
+    static std::atomic<const prop_info*> handle;
+    static_assert(std::is_trivially_copyable_v<std::optional<std::int32_t>> && sizeof(std::optional<std::int32_t>) <= sizeof(SerialCache::words));
+    static SerialCache cache;
+    const prop_info* pi = FindCachedProp(&handle, "android.test_int");
+    if (pi == nullptr) return {};
+
+    std::uint32_t serial = __system_property_serial(pi);
+    std::optional<std::int32_t> ret;
+    if (LoadCached(&cache, serial, &ret, sizeof(ret))) return ret;
+    GetProp(pi, &ret);
+    StoreCached(&cache, serial, &ret, sizeof(ret));
+    return ret;
+}
+
+bool test_int(const std::optional<std::int32_t>& value) {
+    return __system_property_set("android.test_int", FormatValue(value).c_str()) == 0;
+}
+
+std::optional<std::string> test_string() {
+    static std::atomic<const prop_info*> handle;
+    const prop_info* pi = FindCachedProp(&handle, "ro.android.test.string");
+    if (pi == nullptr) return {};
+
+    // ro. properties never change once they are set.
+    static const std::optional<std::string> memo = [pi] {
+        std::optional<std::string> ret;
+        GetProp(pi, &ret);
+        return ret;
+    }();
+    return memo;
+}
+
+}  // namespace android::sysprop::InstrumentedProperties
+)";
+
+constexpr const char* kExpectedProfileReportOutput =
+    R"(# Access strategies of android.sysprop.InstrumentedProperties, from a profile of 10.00 seconds.
+test_int: serial-cache (read more often than changed, 100.00 reads/s, 0.20 changes/s)
+test_string: memoize (immutable once set, 5.00 reads/s, 0.00 changes/s)
+# Ignored unknown property test_removed
+)";
+
+constexpr const char* kTestProfileStringSyspropFile =
+    R"(owner: Platform
+module: "android.sysprop.ProfiledStringProperties"
+prop {
+    api_name: "test_string"
+    type: String
+    prop_name: "android.test.string"
+    scope: Public
+    access: ReadWrite
+}
+)";
+
+constexpr const char* kTestProfileStringFile =
+    R"(duration_seconds: 10
+prop {
+    api_name: "test_string"
+    reads: 1000
+    writes: 2
+}
+)";
+
+constexpr const char* kExpectedProfileStringReportOutput =
+    R"(# Access strategies of android.sysprop.ProfiledStringProperties, from a profile of 10.00 seconds.
+test_string: cached-handle (read more often than changed but serial caches only hold scalars, 100.00 reads/s, 0.20 changes/s)
+)";
+
+// Generates the files of `name`.sysprop with `options`, and compares them to
+// the expected outputs. Outputs which are null aren't compared.
+void ExpectCppGenOutputs(
+    const char* sysprop, const std::string& name, const CppGenOptions& options,
+    const char* header, const char* public_header, const char* source,
+    std::initializer_list<std::pair<std::string, const char*>> extra = {}) {
+  TemporaryDir temp_dir;
+
+  std::string temp_sysprop_path = temp_dir.path + "/"s + name + ".sysprop";
+  ASSERT_TRUE(android::base::WriteStringToFile(sysprop, temp_sysprop_path));
+
+  std::vector<std::pair<std::string, const char*>> outputs = {
+      {name + ".sysprop.h", header},
+      {"public/" + name + ".sysprop.h", public_header},
+      {name + ".sysprop.cpp", source},
+  };
+  outputs.insert(outputs.end(), extra.begin(), extra.end());
+
+  auto file_deleter = android::base::make_scope_guard([&] {
+    unlink(temp_sysprop_path.c_str());
+    for (const auto& [path, expected] : outputs) {
+      unlink((temp_dir.path + "/"s + path).c_str());
+    }
+    rmdir((temp_dir.path + "/public"s).c_str());
+  });
+
+  ASSERT_RESULT_OK(GenerateCppFiles(
+      temp_sysprop_path, temp_dir.path, temp_dir.path + "/public"s,
+      temp_dir.path, "properties/" + name + ".sysprop.h", options));
+
+  for (const auto& [path, expected] : outputs) {
+    if (expected == nullptr) continue;
+
+    std::string output;
+    ASSERT_TRUE(android::base::ReadFileToString(temp_dir.path + "/"s + path,
+                                                &output, true));
+    EXPECT_EQ(output, expected) << path;
+  }
+}
+
+TEST(SyspropTest, CppGenTest) {
+  ExpectCppGenOutputs(kTestSyspropFile, "PlatformProperties", {},
+                      kExpectedHeaderOutput, kExpectedPublicHeaderOutput,
+                      kExpectedSourceOutput);
+}
+
+TEST(SyspropTest, CppGenTableDrivenTest) {
+  CppGenOptions options;
+  options.table_driven = true;
+  ExpectCppGenOutputs(kTestTableDrivenSyspropFile, "TableProperties", options,
+                      kExpectedTableDrivenHeaderOutput,
+                      kExpectedTableDrivenPublicHeaderOutput,
+                      kExpectedTableDrivenSourceOutput);
+}
+
+TEST(SyspropTest, CppGenInstrumentedTest) {
+  CppGenOptions options;
+  options.instrumented = true;
+  ExpectCppGenOutputs(kTestInstrumentedSyspropFile, "InstrumentedProperties",
+                      options, kExpectedInstrumentedHeaderOutput,
+                      kExpectedInstrumentedPublicHeaderOutput,
+                      kExpectedInstrumentedSourceOutput);
+}
+
+TEST(SyspropTest, CppGenModuleRegistryTest) {
+  CppGenOptions options;
+  options.module_registry = true;
+  ExpectCppGenOutputs(kTestInstrumentedSyspropFile, "InstrumentedProperties",
+                      options, kExpectedModuleRegistryHeaderOutput,
+                      kExpectedModuleRegistryPublicHeaderOutput,
+                      kExpectedModuleRegistrySourceOutput);
+}
+
+TEST(SyspropTest, CppGenSnapshotTest) {
+  CppGenOptions options;
+  options.snapshot = true;
+  ExpectCppGenOutputs(kTestSnapshotSyspropFile, "SnapshotProperties", options,
+                      kExpectedSnapshotHeaderOutput,
+                      kExpectedSnapshotPublicHeaderOutput,
+                      kExpectedSnapshotSourceOutput);
+}
+
+TEST(SyspropTest, CppGenProfileTest) {
+  TemporaryFile temp_profile;
+  ASSERT_TRUE(
+      android::base::WriteStringToFile(kTestProfileFile, temp_profile.path));
+
+  CppGenOptions options;
+  options.profile_file = temp_profile.path;
+  ExpectCppGenOutputs(
+      kTestInstrumentedSyspropFile, "InstrumentedProperties", options, nullptr,
+      nullptr, kExpectedProfileSourceOutput,
+      {{"InstrumentedProperties.sysprop.access.txt",
+        kExpectedProfileReportOutput}});
+}
+
+TEST(SyspropTest, CppGenProfileStringTest) {
+  TemporaryFile temp_profile;
+  ASSERT_TRUE(android::base::WriteStringToFile(kTestProfileStringFile,
+                                               temp_profile.path));
+
+  CppGenOptions options;
+  options.profile_file = temp_profile.path;
+  ExpectCppGenOutputs(
+      kTestProfileStringSyspropFile, "ProfiledStringProperties", options,
+      nullptr, nullptr, nullptr,
+      {{"ProfiledStringProperties.sysprop.access.txt",
+        kExpectedProfileStringReportOutput}});
+}
+
+TEST(SyspropTest, CppGenProfileTableDrivenTest) {
+  TemporaryDir temp_dir;
+
+  std::string temp_sysprop_path =
+      temp_dir.path + "/InstrumentedProperties.sysprop"s;
+  std::string temp_profile_path = temp_dir.path + "/profile.txt"s;
+  ASSERT_TRUE(android::base::WriteStringToFile(kTestInstrumentedSyspropFile,
+                                               temp_sysprop_path));
+  ASSERT_TRUE(
+      android::base::WriteStringToFile(kTestProfileFile, temp_profile_path));
+
+  CppGenOptions options;
+  options.table_driven = true;
+  options.profile_file = temp_profile_path;
+  auto res = GenerateCppFiles(
+      temp_sysprop_path, temp_dir.path, temp_dir.path + "/public"s,
+      temp_dir.path, "properties/InstrumentedProperties.sysprop.h", options);
+  EXPECT_FALSE(res.ok());
+  if (!res.ok()) {
+    EXPECT_EQ(res.error().message(),
+              "Profiles can't be used with table-driven accessors");
+  }
+
+  // Nothing is written when the options are rejected.
+  std::string header_path =
+      temp_dir.path + "/InstrumentedProperties.sysprop.h"s;
+  EXPECT_NE(access(header_path.c_str(), F_OK), 0);
+
+  unlink(temp_sysprop_path.c_str());
+  unlink(temp_profile_path.c_str());
 }
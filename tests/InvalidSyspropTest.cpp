@@ -152,6 +152,54 @@ prop {
 }
 )";
 
+constexpr const char* kEmptyStructFields =
+    R"(
+owner: Platform
+module: "android.os.StructProp"
+prop {
+    api_name: "empty_struct"
+    type: Struct
+    scope: Internal
+    access: ReadWrite
+}
+)";
+
+constexpr const char* kDuplicatedStructField =
+    R"(
+owner: Platform
+module: "android.os.StructProp"
+prop {
+    api_name: "display"
+    type: Struct
+    scope: Internal
+    access: ReadWrite
+    struct_fields {
+        name: "width"
+        type: Integer
+    }
+    struct_fields {
+        name: "width"
+        type: Long
+    }
+}
+)";
+
+constexpr const char* kStructFieldWithListType =
+    R"(
+owner: Platform
+module: "android.os.StructProp"
+prop {
+    api_name: "display"
+    type: Struct
+    scope: Internal
+    access: ReadWrite
+    struct_fields {
+        name: "modes"
+        type: IntegerList
+    }
+}
+)";
+
 /*
  * TODO: Some properties don't have prefix "ro." but not written in any
  * Java or C++ codes. They might be misnamed and should be readonly. Will
@@ -188,13 +236,65 @@ constexpr const char* kTestCasesAndExpectedErrors[][2] = {
      "\"ro.\""},
     {kIntegerAsBoolWithWrongType,
      "Prop \"long.prop\" has integer_as_bool: true, but not a boolean"},
+    {kEmptyStructFields, "Struct fields are empty for API \"empty_struct\""},
+    {kDuplicatedStructField,
+     "Duplicated struct field \"width\" for API \"display\""},
+    {kStructFieldWithListType,
+     "Struct field \"modes\" for API \"display\" should have a non-list, "
+     "non-struct type"},
     /*    {kNoRoPrefixForReadonlyProperty,
          "Prop \"odm.i_am_readwrite\" isn't ReadWrite, but don't have prefix "
          "\"ro.\""},*/
 };
 
+constexpr const char* kUnparsableProfile =
+    R"(
+duration_seconds: ten
+)";
+
+constexpr const char* kZeroDurationProfile =
+    R"(
+prop {
+    api_name: "status"
+    reads: 10
+}
+)";
+
+constexpr const char* kDuplicatedProfileEntry =
+    R"(
+duration_seconds: 10
+prop {
+    api_name: "status"
+    reads: 10
+}
+prop {
+    api_name: "status"
+    reads: 20
+}
+)";
+
+constexpr const char* kNegativeChangeRateProfile =
+    R"(
+duration_seconds: 10
+prop {
+    api_name: "status"
+    reads: 10
+    changes_per_second: -1
+}
+)";
+
+// The errors follow "Error parsing file <path>".
+constexpr const char* kProfileTestCasesAndExpectedErrors[][2] = {
+    {kUnparsableProfile, ""},
+    {kZeroDurationProfile, ": duration_seconds must be positive"},
+    {kDuplicatedProfileEntry, ": duplicated api_name status"},
+    {kNegativeChangeRateProfile, ": invalid changes_per_second of status"},
+};
+
 }  // namespace
 
+using namespace std::string_literals;
+
 TEST(SyspropTest, InvalidSyspropTest) {
   TemporaryFile file;
   close(file.fd);
@@ -207,3 +307,17 @@ TEST(SyspropTest, InvalidSyspropTest) {
     EXPECT_EQ(res.error().message(), expected_error);
   }
 }
+
+TEST(SyspropTest, InvalidAccessProfileTest) {
+  TemporaryFile file;
+  close(file.fd);
+  file.fd = -1;
+
+  for (auto [test_case, expected_error] : kProfileTestCasesAndExpectedErrors) {
+    ASSERT_TRUE(android::base::WriteStringToFile(test_case, file.path));
+    auto res = ParseAccessProfile(file.path);
+    EXPECT_FALSE(res.ok());
+    EXPECT_EQ(res.error().message(),
+              "Error parsing file "s + file.path + expected_error);
+  }
+}
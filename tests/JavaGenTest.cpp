@@ -98,6 +98,37 @@ prop {
     access: ReadWrite
     deprecated: true
 }
+prop {
+    api_name: "test_struct"
+    type: Struct
+    scope: Public
+    access: ReadWrite
+    struct_fields {
+        name: "width"
+        type: Integer
+    }
+    struct_fields {
+        name: "label"
+        type: String
+    }
+    struct_fields {
+        name: "mode"
+        type: Enum
+        enum_values: "on|off"
+    }
+}
+prop {
+    api_name: "test_string_map"
+    type: StringMap
+    scope: Public
+    access: ReadWrite
+}
+prop {
+    api_name: "test_int_map"
+    type: IntegerMap
+    scope: Internal
+    access: Readonly
+}
 )";
 
 constexpr const char* kExpectedPublicOutput =
@@ -109,11 +140,14 @@ import android.os.SystemProperties;
 
 import java.lang.StringBuilder;
 import java.util.ArrayList;
+import java.util.EnumSet;
 import java.util.function.Function;
 import java.util.List;
 import java.util.Locale;
+import java.util.Map;
 import java.util.Optional;
 import java.util.StringJoiner;
+import java.util.TreeMap;
 import java.util.stream.Collectors;
 
 public final class TestProperties {
@@ -201,6 +235,41 @@ public final class TestProperties {
         return ret;
     }
 
+    private static <T extends Enum<T>> EnumSet<T> tryParseEnumSet(Class<T> enumType, String str) {
+        EnumSet<T> ret = EnumSet.noneOf(enumType);
+        if ("".equals(str)) return ret;
+
+        for (String element : str.split(",")) {
+            T value = tryParseEnum(enumType, element);
+            if (value != null) ret.add(value);
+        }
+
+        return ret;
+    }
+
+    private static <T> Map<String, T> tryParseMap(Function<String, T> valueParser, String str) {
+        Map<String, T> ret = new TreeMap<>();
+
+        int p = 0;
+        while (p < str.length()) {
+            StringBuilder key = new StringBuilder();
+            StringBuilder value = new StringBuilder();
+            StringBuilder token = key;
+            for (; p < str.length() && str.charAt(p) != ','; ++p) {
+                if (str.charAt(p) == '=' && token == key) {
+                    token = value;
+                    continue;
+                }
+                if (str.charAt(p) == '\\' && p + 1 < str.length()) ++p;
+                token.append(str.charAt(p));
+            }
+            ++p;
+            ret.put(key.toString(), valueParser.apply(value.toString()));
+        }
+
+        return ret;
+    }
+
     private static String escape(String str) {
         return str.replaceAll("([\\\\,])", "\\\\$1");
     }
@@ -215,7 +284,23 @@ public final class TestProperties {
         return joiner.toString();
     }
 
-    private static <T extends Enum<T>> String formatEnumList(List<T> list, Function<T, String> elementFormatter) {
+    private static String escapeMapToken(String str) {
+        return str.replaceAll("([\\\\,=])", "\\\\$1");
+    }
+
+    private static <T> String formatMap(Map<String, T> map) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (Map.Entry<String, T> entry : map.entrySet()) {
+            T value = entry.getValue();
+            joiner.add(escapeMapToken(entry.getKey()) + "="
+                    + (value == null ? "" : escapeMapToken(value.toString())));
+        }
+
+        return joiner.toString();
+    }
+
+    private static <T extends Enum<T>> String formatEnumList(Iterable<T> list, Function<T, String> elementFormatter) {
         StringJoiner joiner = new StringJoiner(",");
 
         for (T element : list) {
@@ -280,6 +365,65 @@ public final class TestProperties {
     public static void test_strlist(List<String> value) {
         SystemProperties.set("vendor.test_strlist", value == null ? "" : formatList(value));
     }
+
+    public static final class test_struct_values {
+        public static enum mode_values {
+            ON("on"),
+            OFF("off");
+            private final String propValue;
+            private mode_values(String propValue) {
+                this.propValue = propValue;
+            }
+            public String getPropValue() {
+                return propValue;
+            }
+        }
+
+        public final Integer width;
+        public final String label;
+        public final mode_values mode;
+
+        public test_struct_values(Integer width, String label, mode_values mode) {
+            this.width = width;
+            this.label = label;
+            this.mode = mode;
+        }
+
+        private static test_struct_values tryParse(String str) {
+            if ("".equals(str)) return null;
+            List<String> fields = tryParseList(v -> v, str);
+            return new test_struct_values(
+                    fields.size() > 0 ? tryParseInteger(fields.get(0)) : null,
+                    fields.size() > 1 ? tryParseString(fields.get(1)) : null,
+                    fields.size() > 2 ? tryParseEnum(mode_values.class, fields.get(2)) : null);
+        }
+
+        public String getPropValue() {
+            StringJoiner joiner = new StringJoiner(",");
+            joiner.add(width == null ? "" : width.toString());
+            joiner.add(label == null ? "" : escape(label));
+            joiner.add(mode == null ? "" : mode.getPropValue());
+            return joiner.toString();
+        }
+    }
+
+    public static Optional<test_struct_values> test_struct() {
+        String value = SystemProperties.get("vendor.test_struct");
+        return Optional.ofNullable(test_struct_values.tryParse(value));
+    }
+
+    public static void test_struct(test_struct_values value) {
+        SystemProperties.set("vendor.test_struct", value == null ? "" : value.getPropValue());
+    }
+
+    public static Map<String, String> test_string_map() {
+        String value = SystemProperties.get("vendor.test_string_map");
+        return tryParseMap(v -> tryParseString(v), value);
+    }
+
+    public static void test_string_map(Map<String, String> value) {
+        SystemProperties.set("vendor.test_string_map", value == null ? "" : formatMap(value));
+    }
 }
 )s";
 
@@ -292,11 +436,14 @@ import android.os.SystemProperties;
 
 import java.lang.StringBuilder;
 import java.util.ArrayList;
+import java.util.EnumSet;
 import java.util.function.Function;
 import java.util.List;
 import java.util.Locale;
+import java.util.Map;
 import java.util.Optional;
 import java.util.StringJoiner;
+import java.util.TreeMap;
 import java.util.stream.Collectors;
 
 public final class TestProperties {
@@ -384,6 +531,41 @@ public final class TestProperties {
         return ret;
     }
 
+    private static <T extends Enum<T>> EnumSet<T> tryParseEnumSet(Class<T> enumType, String str) {
+        EnumSet<T> ret = EnumSet.noneOf(enumType);
+        if ("".equals(str)) return ret;
+
+        for (String element : str.split(",")) {
+            T value = tryParseEnum(enumType, element);
+            if (value != null) ret.add(value);
+        }
+
+        return ret;
+    }
+
+    private static <T> Map<String, T> tryParseMap(Function<String, T> valueParser, String str) {
+        Map<String, T> ret = new TreeMap<>();
+
+        int p = 0;
+        while (p < str.length()) {
+            StringBuilder key = new StringBuilder();
+            StringBuilder value = new StringBuilder();
+            StringBuilder token = key;
+            for (; p < str.length() && str.charAt(p) != ','; ++p) {
+                if (str.charAt(p) == '=' && token == key) {
+                    token = value;
+                    continue;
+                }
+                if (str.charAt(p) == '\\' && p + 1 < str.length()) ++p;
+                token.append(str.charAt(p));
+            }
+            ++p;
+            ret.put(key.toString(), valueParser.apply(value.toString()));
+        }
+
+        return ret;
+    }
+
     private static String escape(String str) {
         return str.replaceAll("([\\\\,])", "\\\\$1");
     }
@@ -398,7 +580,23 @@ public final class TestProperties {
         return joiner.toString();
     }
 
-    private static <T extends Enum<T>> String formatEnumList(List<T> list, Function<T, String> elementFormatter) {
+    private static String escapeMapToken(String str) {
+        return str.replaceAll("([\\\\,=])", "\\\\$1");
+    }
+
+    private static <T> String formatMap(Map<String, T> map) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (Map.Entry<String, T> entry : map.entrySet()) {
+            T value = entry.getValue();
+            joiner.add(escapeMapToken(entry.getKey()) + "="
+                    + (value == null ? "" : escapeMapToken(value.toString())));
+        }
+
+        return joiner.toString();
+    }
+
+    private static <T extends Enum<T>> String formatEnumList(Iterable<T> list, Function<T, String> elementFormatter) {
         StringJoiner joiner = new StringJoiner(",");
 
         for (T element : list) {
@@ -531,6 +729,81 @@ public final class TestProperties {
     public static void el(List<el_values> value) {
         SystemProperties.set("vendor.el", value == null ? "" : formatEnumList(value, el_values::getPropValue));
     }
+
+    @Deprecated
+    public static EnumSet<el_values> el_flags() {
+        String value = SystemProperties.get("vendor.el");
+        return tryParseEnumSet(el_values.class, value);
+    }
+
+    @Deprecated
+    public static void el_flags(EnumSet<el_values> value) {
+        SystemProperties.set("vendor.el", value == null ? "" : formatEnumList(value, el_values::getPropValue));
+    }
+
+    public static final class test_struct_values {
+        public static enum mode_values {
+            ON("on"),
+            OFF("off");
+            private final String propValue;
+            private mode_values(String propValue) {
+                this.propValue = propValue;
+            }
+            public String getPropValue() {
+                return propValue;
+            }
+        }
+
+        public final Integer width;
+        public final String label;
+        public final mode_values mode;
+
+        public test_struct_values(Integer width, String label, mode_values mode) {
+            this.width = width;
+            this.label = label;
+            this.mode = mode;
+        }
+
+        private static test_struct_values tryParse(String str) {
+            if ("".equals(str)) return null;
+            List<String> fields = tryParseList(v -> v, str);
+            return new test_struct_values(
+                    fields.size() > 0 ? tryParseInteger(fields.get(0)) : null,
+                    fields.size() > 1 ? tryParseString(fields.get(1)) : null,
+                    fields.size() > 2 ? tryParseEnum(mode_values.class, fields.get(2)) : null);
+        }
+
+        public String getPropValue() {
+            StringJoiner joiner = new StringJoiner(",");
+            joiner.add(width == null ? "" : width.toString());
+            joiner.add(label == null ? "" : escape(label));
+            joiner.add(mode == null ? "" : mode.getPropValue());
+            return joiner.toString();
+        }
+    }
+
+    public static Optional<test_struct_values> test_struct() {
+        String value = SystemProperties.get("vendor.test_struct");
+        return Optional.ofNullable(test_struct_values.tryParse(value));
+    }
+
+    public static void test_struct(test_struct_values value) {
+        SystemProperties.set("vendor.test_struct", value == null ? "" : value.getPropValue());
+    }
+
+    public static Map<String, String> test_string_map() {
+        String value = SystemProperties.get("vendor.test_string_map");
+        return tryParseMap(v -> tryParseString(v), value);
+    }
+
+    public static void test_string_map(Map<String, String> value) {
+        SystemProperties.set("vendor.test_string_map", value == null ? "" : formatMap(value));
+    }
+
+    public static Map<String, Integer> test_int_map() {
+        String value = SystemProperties.get("ro.vendor.test_int_map");
+        return tryParseMap(v -> tryParseInteger(v), value);
+    }
 }
 )s";
 
@@ -538,35 +811,725 @@ public final class TestProperties {
 
 using namespace std::string_literals;
 
-TEST(SyspropTest, JavaGenTest) {
-  TemporaryFile temp_file;
+constexpr const char* kTestPreloadSyspropFile =
+    R"(owner: Platform
+module: "com.somecompany.PreloadProperties"
 
-  // strlen is optimized for constants, so don't worry about it.
-  ASSERT_EQ(write(temp_file.fd, kTestSyspropFile, strlen(kTestSyspropFile)),
-            strlen(kTestSyspropFile));
-  close(temp_file.fd);
-  temp_file.fd = -1;
+prop {
+    api_name: "test_int"
+    type: Integer
+    prop_name: "ro.test.int"
+    scope: Public
+    access: Readonly
+}
+prop {
+    api_name: "test_list"
+    type: StringList
+    prop_name: "ro.test.list"
+    scope: Internal
+    access: Readonly
+}
+prop {
+    api_name: "test_writable"
+    type: Boolean
+    prop_name: "test.writable"
+    scope: Public
+    access: ReadWrite
+}
+)";
 
-  TemporaryDir temp_dir;
+constexpr const char* kExpectedPreloadOutput =
+    R"s(// Generated by the sysprop generator. DO NOT EDIT!
 
-  std::pair<sysprop::Scope, const char*> tests[] = {
-      {sysprop::Scope::Internal, kExpectedInternalOutput},
-      {sysprop::Scope::Public, kExpectedPublicOutput},
-  };
+package com.somecompany;
 
-  for (auto [scope, expected_output] : tests) {
-    ASSERT_RESULT_OK(GenerateJavaLibrary(temp_file.path, scope, temp_dir.path));
+import android.os.SystemProperties;
 
-    std::string java_output_path =
-        temp_dir.path + "/com/somecompany/TestProperties.java"s;
+import java.lang.StringBuilder;
+import java.util.ArrayList;
+import java.util.EnumSet;
+import java.util.function.Function;
+import java.util.List;
+import java.util.Locale;
+import java.util.Map;
+import java.util.Optional;
+import java.util.StringJoiner;
+import java.util.TreeMap;
+import java.util.stream.Collectors;
 
-    std::string java_output;
-    ASSERT_TRUE(
-        android::base::ReadFileToString(java_output_path, &java_output, true));
-    EXPECT_EQ(java_output, expected_output);
+public final class PreloadProperties {
+    private PreloadProperties () {}
 
-    unlink(java_output_path.c_str());
-    rmdir((temp_dir.path + "/com/somecompany"s).c_str());
-    rmdir((temp_dir.path + "/com"s).c_str());
-  }
+    private static Boolean tryParseBoolean(String str) {
+        switch (str.toLowerCase(Locale.US)) {
+            case "1":
+            case "true":
+                return Boolean.TRUE;
+            case "0":
+            case "false":
+                return Boolean.FALSE;
+            default:
+                return null;
+        }
+    }
+
+    private static Integer tryParseInteger(String str) {
+        try {
+            return Integer.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static Long tryParseLong(String str) {
+        try {
+            return Long.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static Double tryParseDouble(String str) {
+        try {
+            return Double.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static String tryParseString(String str) {
+        return "".equals(str) ? null : str;
+    }
+
+    private static <T extends Enum<T>> T tryParseEnum(Class<T> enumType, String str) {
+        try {
+            return Enum.valueOf(enumType, str.toUpperCase(Locale.US));
+        } catch (IllegalArgumentException e) {
+            return null;
+        }
+    }
+
+    private static <T> List<T> tryParseList(Function<String, T> elementParser, String str) {
+        if ("".equals(str)) return new ArrayList<>();
+
+        List<T> ret = new ArrayList<>();
+
+        int p = 0;
+        for (;;) {
+            StringBuilder sb = new StringBuilder();
+            while (p < str.length() && str.charAt(p) != ',') {
+                if (str.charAt(p) == '\\') ++p;
+                if (p == str.length()) break;
+                sb.append(str.charAt(p++));
+            }
+            ret.add(elementParser.apply(sb.toString()));
+            if (p == str.length()) break;
+            ++p;
+        }
+
+        return ret;
+    }
+
+    private static <T extends Enum<T>> List<T> tryParseEnumList(Class<T> enumType, String str) {
+        if ("".equals(str)) return new ArrayList<>();
+
+        List<T> ret = new ArrayList<>();
+
+        for (String element : str.split(",")) {
+            ret.add(tryParseEnum(enumType, element));
+        }
+
+        return ret;
+    }
+
+    private static <T extends Enum<T>> EnumSet<T> tryParseEnumSet(Class<T> enumType, String str) {
+        EnumSet<T> ret = EnumSet.noneOf(enumType);
+        if ("".equals(str)) return ret;
+
+        for (String element : str.split(",")) {
+            T value = tryParseEnum(enumType, element);
+            if (value != null) ret.add(value);
+        }
+
+        return ret;
+    }
+
+    private static <T> Map<String, T> tryParseMap(Function<String, T> valueParser, String str) {
+        Map<String, T> ret = new TreeMap<>();
+
+        int p = 0;
+        while (p < str.length()) {
+            StringBuilder key = new StringBuilder();
+            StringBuilder value = new StringBuilder();
+            StringBuilder token = key;
+            for (; p < str.length() && str.charAt(p) != ','; ++p) {
+                if (str.charAt(p) == '=' && token == key) {
+                    token = value;
+                    continue;
+                }
+                if (str.charAt(p) == '\\' && p + 1 < str.length()) ++p;
+                token.append(str.charAt(p));
+            }
+            ++p;
+            ret.put(key.toString(), valueParser.apply(value.toString()));
+        }
+
+        return ret;
+    }
+
+    private static String escape(String str) {
+        return str.replaceAll("([\\\\,])", "\\\\$1");
+    }
+
+    private static <T> String formatList(List<T> list) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (T element : list) {
+            joiner.add(element == null ? "" : escape(element.toString()));
+        }
+
+        return joiner.toString();
+    }
+
+    private static String escapeMapToken(String str) {
+        return str.replaceAll("([\\\\,=])", "\\\\$1");
+    }
+
+    private static <T> String formatMap(Map<String, T> map) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (Map.Entry<String, T> entry : map.entrySet()) {
+            T value = entry.getValue();
+            joiner.add(escapeMapToken(entry.getKey()) + "="
+                    + (value == null ? "" : escapeMapToken(value.toString())));
+        }
+
+        return joiner.toString();
+    }
+
+    private static <T extends Enum<T>> String formatEnumList(Iterable<T> list, Function<T, String> elementFormatter) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (T element : list) {
+            joiner.add(element == null ? "" : elementFormatter.apply(element));
+        }
+
+        return joiner.toString();
+    }
+
+    public static Optional<Integer> test_int() {
+        Preloaded cache = preloaded;
+        if (cache != null && cache.test_int != null) return cache.test_int;
+        String value = SystemProperties.get("ro.test.int");
+        return Optional.ofNullable(tryParseInteger(value));
+    }
+
+    public static List<String> test_list() {
+        Preloaded cache = preloaded;
+        if (cache != null && cache.test_list != null) {
+            return new ArrayList<>(cache.test_list);
+        }
+        String value = SystemProperties.get("ro.test.list");
+        return tryParseList(v -> tryParseString(v), value);
+    }
+
+    public static Optional<Boolean> test_writable() {
+        String value = SystemProperties.get("test.writable");
+        return Optional.ofNullable(tryParseBoolean(value));
+    }
+
+    public static void test_writable(Boolean value) {
+        SystemProperties.set("test.writable", value == null ? "" : value.toString());
+    }
+
+    private static final class Preloaded {
+        final Optional<Integer> test_int;
+        final List<String> test_list;
+
+        Preloaded() {
+            String value;
+            value = SystemProperties.get("ro.test.int");
+            test_int = value.isEmpty() ? null : Optional.ofNullable(tryParseInteger(value));
+            value = SystemProperties.get("ro.test.list");
+            test_list = value.isEmpty() ? null : tryParseList(v -> tryParseString(v), value);
+        }
+    }
+
+    private static volatile Preloaded preloaded;
+
+    public static void preload() {
+        preloaded = new Preloaded();
+    }
+}
+)s";
+
+constexpr const char* kTestProfileSyspropFile =
+    R"(owner: Platform
+module: "com.somecompany.ProfiledProperties"
+prop {
+    api_name: "test_int"
+    type: Integer
+    prop_name: "android.test_int"
+    scope: Public
+    access: ReadWrite
+}
+prop {
+    api_name: "test_string"
+    type: String
+    prop_name: "ro.android.test.string"
+    scope: Internal
+    access: Readonly
+}
+prop {
+    api_name: "test_list"
+    type: IntegerList
+    prop_name: "ro.android.test.list"
+    scope: Internal
+    access: Readonly
+}
+prop {
+    api_name: "test_features"
+    type: EnumList
+    enum_values: "a|b|c"
+    prop_name: "ro.android.test.features"
+    scope: Internal
+    access: Readonly
+}
+prop {
+    api_name: "test_modes"
+    type: EnumList
+    enum_values: "x|y"
+    prop_name: "android.test.modes"
+    scope: Internal
+    access: ReadWrite
+}
+)";
+
+constexpr const char* kTestProfileFile =
+    R"(duration_seconds: 10
+prop {
+    api_name: "test_int"
+    reads: 1000
+    writes: 2
+}
+prop {
+    api_name: "test_string"
+    reads: 50
+}
+prop {
+    api_name: "test_list"
+    reads: 40
+}
+prop {
+    api_name: "test_features"
+    reads: 30
+}
+prop {
+    api_name: "test_modes"
+    reads: 100
+    changes_per_second: 5
+}
+)";
+
+constexpr const char* kExpectedProfileOutput =
+    R"s(// Generated by the sysprop generator. DO NOT EDIT!
+
+package com.somecompany;
+
+import android.os.SystemProperties;
+
+import java.lang.StringBuilder;
+import java.util.ArrayList;
+import java.util.EnumSet;
+import java.util.function.Function;
+import java.util.List;
+import java.util.Locale;
+import java.util.Map;
+import java.util.Optional;
+import java.util.StringJoiner;
+import java.util.TreeMap;
+import java.util.stream.Collectors;
+
+public final class ProfiledProperties {
+    private ProfiledProperties () {}
+
+    private static Boolean tryParseBoolean(String str) {
+        switch (str.toLowerCase(Locale.US)) {
+            case "1":
+            case "true":
+                return Boolean.TRUE;
+            case "0":
+            case "false":
+                return Boolean.FALSE;
+            default:
+                return null;
+        }
+    }
+
+    private static Integer tryParseInteger(String str) {
+        try {
+            return Integer.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static Long tryParseLong(String str) {
+        try {
+            return Long.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static Double tryParseDouble(String str) {
+        try {
+            return Double.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static String tryParseString(String str) {
+        return "".equals(str) ? null : str;
+    }
+
+    private static <T extends Enum<T>> T tryParseEnum(Class<T> enumType, String str) {
+        try {
+            return Enum.valueOf(enumType, str.toUpperCase(Locale.US));
+        } catch (IllegalArgumentException e) {
+            return null;
+        }
+    }
+
+    private static <T> List<T> tryParseList(Function<String, T> elementParser, String str) {
+        if ("".equals(str)) return new ArrayList<>();
+
+        List<T> ret = new ArrayList<>();
+
+        int p = 0;
+        for (;;) {
+            StringBuilder sb = new StringBuilder();
+            while (p < str.length() && str.charAt(p) != ',') {
+                if (str.charAt(p) == '\\') ++p;
+                if (p == str.length()) break;
+                sb.append(str.charAt(p++));
+            }
+            ret.add(elementParser.apply(sb.toString()));
+            if (p == str.length()) break;
+            ++p;
+        }
+
+        return ret;
+    }
+
+    private static <T extends Enum<T>> List<T> tryParseEnumList(Class<T> enumType, String str) {
+        if ("".equals(str)) return new ArrayList<>();
+
+        List<T> ret = new ArrayList<>();
+
+        for (String element : str.split(",")) {
+            ret.add(tryParseEnum(enumType, element));
+        }
+
+        return ret;
+    }
+
+    private static <T extends Enum<T>> EnumSet<T> tryParseEnumSet(Class<T> enumType, String str) {
+        EnumSet<T> ret = EnumSet.noneOf(enumType);
+        if ("".equals(str)) return ret;
+
+        for (String element : str.split(",")) {
+            T value = tryParseEnum(enumType, element);
+            if (value != null) ret.add(value);
+        }
+
+        return ret;
+    }
+
+    private static <T> Map<String, T> tryParseMap(Function<String, T> valueParser, String str) {
+        Map<String, T> ret = new TreeMap<>();
+
+        int p = 0;
+        while (p < str.length()) {
+            StringBuilder key = new StringBuilder();
+            StringBuilder value = new StringBuilder();
+            StringBuilder token = key;
+            for (; p < str.length() && str.charAt(p) != ','; ++p) {
+                if (str.charAt(p) == '=' && token == key) {
+                    token = value;
+                    continue;
+                }
+                if (str.charAt(p) == '\\' && p + 1 < str.length()) ++p;
+                token.append(str.charAt(p));
+            }
+            ++p;
+            ret.put(key.toString(), valueParser.apply(value.toString()));
+        }
+
+        return ret;
+    }
+
+    private static String escape(String str) {
+        return str.replaceAll("([\\\\,])", "\\\\$1");
+    }
+
+    private static <T> String formatList(List<T> list) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (T element : list) {
+            joiner.add(element == null ? "" : escape(element.toString()));
+        }
+
+        return joiner.toString();
+    }
+
+    private static String escapeMapToken(String str) {
+        return str.replaceAll("([\\\\,=])", "\\\\$1");
+    }
+
+    private static <T> String formatMap(Map<String, T> map) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (Map.Entry<String, T> entry : map.entrySet()) {
+            T value = entry.getValue();
+            joiner.add(escapeMapToken(entry.getKey()) + "="
+                    + (value == null ? "" : escapeMapToken(value.toString())));
+        }
+
+        return joiner.toString();
+    }
+
+    private static <T extends Enum<T>> String formatEnumList(Iterable<T> list, Function<T, String> elementFormatter) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (T element : list) {
+            joiner.add(element == null ? "" : elementFormatter.apply(element));
+        }
+
+        return joiner.toString();
+    }
+
+    private static volatile SystemProperties.Handle test_int_handle;
+
+    public static Optional<Integer> test_int() {
+        SystemProperties.Handle handle = test_int_handle;
+        if (handle == null) {
+            handle = SystemProperties.find("android.test_int");
+            test_int_handle = handle;
+        }
+        String value = handle == null ? "" : handle.get();
+        return Optional.ofNullable(tryParseInteger(value));
+    }
+
+    public static void test_int(Integer value) {
+        SystemProperties.set("android.test_int", value == null ? "" : value.toString());
+    }
+
+    private static volatile Optional<String> test_string_value;
+
+    public static Optional<String> test_string() {
+        Optional<String> memo = test_string_value;
+        if (memo != null) return memo;
+        String value = SystemProperties.get("ro.android.test.string");
+        Optional<String> ret = Optional.ofNullable(tryParseString(value));
+        // ro. properties never change once they are set.
+        if (!value.isEmpty()) test_string_value = ret;
+        return ret;
+    }
+
+    private static volatile List<Integer> test_list_value;
+
+    public static List<Integer> test_list() {
+        List<Integer> memo = test_list_value;
+        if (memo != null) return new ArrayList<>(memo);
+        String value = SystemProperties.get("ro.android.test.list");
+        List<Integer> ret = tryParseList(v -> tryParseInteger(v), value);
+        // ro. properties never change once they are set.
+        if (!value.isEmpty()) test_list_value = new ArrayList<>(ret);
+        return ret;
+    }
+
+    public static enum test_features_values {
+        A("a"),
+        B("b"),
+        C("c");
+        private final String propValue;
+        private test_features_values(String propValue) {
+            this.propValue = propValue;
+        }
+        public String getPropValue() {
+            return propValue;
+        }
+    }
+
+    private static volatile List<test_features_values> test_features_value;
+
+    public static List<test_features_values> test_features() {
+        List<test_features_values> memo = test_features_value;
+        if (memo != null) return new ArrayList<>(memo);
+        String value = SystemProperties.get("ro.android.test.features");
+        List<test_features_values> ret = tryParseEnumList(test_features_values.class, value);
+        // ro. properties never change once they are set.
+        if (!value.isEmpty()) test_features_value = new ArrayList<>(ret);
+        return ret;
+    }
+
+    private static volatile EnumSet<test_features_values> test_features_flags_value;
+
+    public static EnumSet<test_features_values> test_features_flags() {
+        EnumSet<test_features_values> memo = test_features_flags_value;
+        if (memo != null) return EnumSet.copyOf(memo);
+        String value = SystemProperties.get("ro.android.test.features");
+        EnumSet<test_features_values> ret = tryParseEnumSet(test_features_values.class, value);
+        // ro. properties never change once they are set.
+        if (!value.isEmpty()) test_features_flags_value = EnumSet.copyOf(ret);
+        return ret;
+    }
+
+    public static enum test_modes_values {
+        X("x"),
+        Y("y");
+        private final String propValue;
+        private test_modes_values(String propValue) {
+            this.propValue = propValue;
+        }
+        public String getPropValue() {
+            return propValue;
+        }
+    }
+
+    private static volatile SystemProperties.Handle test_modes_handle;
+
+    public static List<test_modes_values> test_modes() {
+        SystemProperties.Handle handle = test_modes_handle;
+        if (handle == null) {
+            handle = SystemProperties.find("android.test.modes");
+            test_modes_handle = handle;
+        }
+        String value = handle == null ? "" : handle.get();
+        return tryParseEnumList(test_modes_values.class, value);
+    }
+
+    public static void test_modes(List<test_modes_values> value) {
+        SystemProperties.set("android.test.modes", value == null ? "" : formatEnumList(value, test_modes_values::getPropValue));
+    }
+
+    public static EnumSet<test_modes_values> test_modes_flags() {
+        SystemProperties.Handle handle = test_modes_handle;
+        if (handle == null) {
+            handle = SystemProperties.find("android.test.modes");
+            test_modes_handle = handle;
+        }
+        String value = handle == null ? "" : handle.get();
+        return tryParseEnumSet(test_modes_values.class, value);
+    }
+
+    public static void test_modes_flags(EnumSet<test_modes_values> value) {
+        SystemProperties.set("android.test.modes", value == null ? "" : formatEnumList(value, test_modes_values::getPropValue));
+    }
+}
+)s";
+
+constexpr const char* kExpectedProfileReportOutput =
+    R"(# Access strategies of com.somecompany.ProfiledProperties, from a profile of 10.00 seconds.
+test_int: cached-handle (read more often than changed but serial caches are unsupported, 100.00 reads/s, 0.20 changes/s)
+test_string: memoize (immutable once set, 5.00 reads/s, 0.00 changes/s)
+test_list: memoize (immutable once set, 4.00 reads/s, 0.00 changes/s)
+test_features: memoize (immutable once set, 3.00 reads/s, 0.00 changes/s)
+test_modes: cached-handle (changes too often to cache, 10.00 reads/s, 5.00 changes/s)
+)";
+
+TEST(SyspropTest, JavaGenTest) {
+  TemporaryFile temp_file;
+
+  // strlen is optimized for constants, so don't worry about it.
+  ASSERT_EQ(write(temp_file.fd, kTestSyspropFile, strlen(kTestSyspropFile)),
+            strlen(kTestSyspropFile));
+  close(temp_file.fd);
+  temp_file.fd = -1;
+
+  TemporaryDir temp_dir;
+
+  std::pair<sysprop::Scope, const char*> tests[] = {
+      {sysprop::Scope::Internal, kExpectedInternalOutput},
+      {sysprop::Scope::Public, kExpectedPublicOutput},
+  };
+
+  for (auto [scope, expected_output] : tests) {
+    ASSERT_RESULT_OK(GenerateJavaLibrary(temp_file.path, scope, temp_dir.path));
+
+    std::string java_output_path =
+        temp_dir.path + "/com/somecompany/TestProperties.java"s;
+
+    std::string java_output;
+    ASSERT_TRUE(
+        android::base::ReadFileToString(java_output_path, &java_output, true));
+    EXPECT_EQ(java_output, expected_output);
+
+    unlink(java_output_path.c_str());
+    rmdir((temp_dir.path + "/com/somecompany"s).c_str());
+    rmdir((temp_dir.path + "/com"s).c_str());
+  }
+}
+
+TEST(SyspropTest, JavaGenPreloadTest) {
+  TemporaryFile temp_file;
+
+  ASSERT_TRUE(android::base::WriteStringToFile(kTestPreloadSyspropFile,
+                                               temp_file.path));
+
+  TemporaryDir temp_dir;
+
+  JavaGenOptions options;
+  options.preload = true;
+  ASSERT_RESULT_OK(GenerateJavaLibrary(temp_file.path, sysprop::Internal,
+                                       temp_dir.path, options));
+
+  std::string java_output_path =
+      temp_dir.path + "/com/somecompany/PreloadProperties.java"s;
+
+  std::string java_output;
+  ASSERT_TRUE(
+      android::base::ReadFileToString(java_output_path, &java_output, true));
+  EXPECT_EQ(java_output, kExpectedPreloadOutput);
+
+  unlink(java_output_path.c_str());
+  rmdir((temp_dir.path + "/com/somecompany"s).c_str());
+  rmdir((temp_dir.path + "/com"s).c_str());
+}
+
+TEST(SyspropTest, JavaGenProfileTest) {
+  TemporaryFile temp_file;
+  TemporaryFile temp_profile;
+
+  ASSERT_TRUE(android::base::WriteStringToFile(kTestProfileSyspropFile,
+                                               temp_file.path));
+  ASSERT_TRUE(
+      android::base::WriteStringToFile(kTestProfileFile, temp_profile.path));
+
+  TemporaryDir temp_dir;
+
+  JavaGenOptions options;
+  options.profile_file = temp_profile.path;
+  ASSERT_RESULT_OK(GenerateJavaLibrary(temp_file.path, sysprop::Internal,
+                                       temp_dir.path, options));
+
+  std::string package_dir = temp_dir.path + "/com/somecompany"s;
+  std::string java_output_path = package_dir + "/ProfiledProperties.java";
+  std::string report_path = package_dir + "/ProfiledProperties.access.txt";
+
+  std::string java_output;
+  ASSERT_TRUE(
+      android::base::ReadFileToString(java_output_path, &java_output, true));
+  EXPECT_EQ(java_output, kExpectedProfileOutput);
+
+  std::string report;
+  ASSERT_TRUE(android::base::ReadFileToString(report_path, &report, true));
+  EXPECT_EQ(report, kExpectedProfileReportOutput);
+
+  unlink(java_output_path.c_str());
+  unlink(report_path.c_str());
+  rmdir(package_dir.c_str());
+  rmdir((temp_dir.path + "/com"s).c_str());
 }
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "sysprop_test/ChangeStats.sysprop.h"
+
+using namespace android::sysprop::test::ChangeStats;
+
+namespace {
+
+// Sets the property and reads it back, so that the getter observes the change.
+void SetAndObserve(std::int32_t v) {
+  ASSERT_TRUE(value(v));
+  ASSERT_EQ(value(), v);
+}
+
+}  // namespace
+
+TEST(ChangeStatsTest, MaxWindowReportsAllKeptChanges) {
+  SetAndObserve(0);  // Sets the baseline.
+  for (std::int32_t i = 1; i <= 4; ++i) SetAndObserve(i);
+
+  std::vector<PropChangeStats> stats =
+      GetPropChangeStats(std::numeric_limits<std::uint64_t>::max());
+  ASSERT_EQ(stats.size(), 1u);
+  EXPECT_EQ(stats[0].total_changes, 4u);
+  EXPECT_EQ(stats[0].recent_changes, 4u);
+  EXPECT_EQ(stats[0].recent_values, 4u);
+  EXPECT_GT(stats[0].changes_per_second, 0.0);
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <sysprop/ModuleRegistry.h>
+
+#include "sysprop_test/RegistryA.sysprop.h"
+#include "sysprop_test/RegistryB.sysprop.h"
+
+// RegistryA is compiled into this test and RegistryB into
+// libsysprop_registry_test_b, so the test sees both modules only if the
+// registry is shared across the library boundary.
+
+TEST(ModuleRegistryTest, RegistersModulesOfAllLibraries) {
+  sysprop::ModuleRegistryStats stats = sysprop::GetModuleRegistryStats();
+  EXPECT_EQ(2u, stats.modules);
+  EXPECT_EQ(4u, stats.props);
+}
+
+TEST(ModuleRegistryTest, ResolvesModulesOfAllLibraries) {
+  sysprop::ModuleRegistryStats stats = sysprop::ResolveAllModules();
+  EXPECT_EQ(2u, stats.modules);
+  // ro.build.version.sdk and ro.build.type exist on every device, unlike the
+  // "missing" properties.
+  EXPECT_EQ(2u, stats.resolved);
+  EXPECT_EQ(2u, stats.unresolved);
+
+  stats = sysprop::ResolveAllModules();
+  EXPECT_EQ(0u, stats.resolved);
+  EXPECT_EQ(2u, stats.unresolved);
+
+  using namespace android::sysprop::test;
+  ASSERT_TRUE(RegistryA::sdk_version().has_value());
+  EXPECT_GT(*RegistryA::sdk_version(), 0);
+  EXPECT_FALSE(RegistryB::build_type().value_or("").empty());
+  EXPECT_FALSE(RegistryA::missing().has_value());
+  EXPECT_FALSE(RegistryB::missing().has_value());
+}